@@ -14,3 +14,28 @@ propro-build-headers: $(PHP_PROPRO_HEADERS)
 .PHONY: propro-clean-headers
 propro-clean-headers:
 	-rm -f $(PHP_PROPRO_HEADERS)
+
+# run each benchmark case in a process of its own; see bench/run.php
+.PHONY: bench
+bench: all
+	@PHP="$(PHP_EXECUTABLE) -n -d extension_dir=$(top_builddir)/modules/ $(PHP_TEST_SHARED_EXTENSIONS)"; \
+	for bench in `$$PHP $(PHP_PROPRO_SRCDIR)/bench/run.php`; do \
+		$$PHP $(PHP_PROPRO_SRCDIR)/bench/run.php $$bench || exit 1; \
+	done
+
+# run the thread stress benchmark of the embed SAPI of a thread-safe PHP;
+# the embed library is libphp<major version> of the PHP of php-config
+PHP_PROPRO_EMBED_LIBDIR = $(shell $(PHP_PROPRO_PHP_CONFIG) --prefix)/lib
+PHP_PROPRO_EMBED_LIB = php$(shell $(PHP_PROPRO_PHP_CONFIG) --vernum | cut -c1)
+PHP_PROPRO_EMBED_LIBS = -L$(PHP_PROPRO_EMBED_LIBDIR) -Wl,-rpath,$(PHP_PROPRO_EMBED_LIBDIR) \
+	$(shell $(PHP_PROPRO_PHP_CONFIG) --ldflags) -l$(PHP_PROPRO_EMBED_LIB) \
+	$(shell $(PHP_PROPRO_PHP_CONFIG) --libs) -lpthread
+
+$(PHP_PROPRO_BUILDDIR)/bench/threads: $(PHP_PROPRO_SRCDIR)/bench/threads.c
+	@mkdir -p $(@D)
+	$(CC) $(CFLAGS_CLEAN) $(INCLUDES) -o $@ $< $(PHP_PROPRO_EMBED_LIBS)
+
+.PHONY: bench-threads
+bench-threads: all $(PHP_PROPRO_BUILDDIR)/bench/threads
+	@echo "extension=$(top_builddir)/modules/propro.so" >$(PHP_PROPRO_BUILDDIR)/bench/php.ini
+	PHPRC=$(PHP_PROPRO_BUILDDIR)/bench $(PHP_PROPRO_BUILDDIR)/bench/threads 1 2 4 8
@@ -0,0 +1,53 @@
+<?php
+
+/*
+ * Append through a proxy to arrays of increasing size, which are shared
+ * with a copy or not.
+ */
+
+function appends_setup($size, $shared) {
+	return function() use($size, $shared) {
+		$o = new stdClass;
+		$o->list = range(1, $size);
+		$copy = $shared ? $o->list : null;
+		return [$o, new php\PropertyProxy($o, "list"), $copy];
+	};
+}
+
+function appends_run($state, $ops) {
+	list(, $p) = $state;
+	for ($i = 0; $i < $ops; ++$i) {
+		$p[] = $i;
+	}
+}
+
+function appends_nested_run($state, $ops) {
+	list(, $p) = $state;
+	$q = new php\PropertyProxy(null, "nested", $p);
+	for ($i = 0; $i < $ops; ++$i) {
+		$q[] = $i;
+	}
+}
+
+return [
+	"empty" => [
+		"ops" => 100000,
+		"setup" => appends_setup(0, false),
+		"run" => "appends_run",
+	],
+	"large" => [
+		"ops" => 100000,
+		"setup" => appends_setup(100000, false),
+		"run" => "appends_run",
+	],
+	"large_shared" => [
+		"ops" => 100000,
+		"setup" => appends_setup(100000, true),
+		"run" => "appends_run",
+	],
+	"nested" => [
+		"ops" => 100000,
+		"setup" => appends_setup(1000, false),
+		"run" => "appends_nested_run",
+	],
+];
@@ -0,0 +1,36 @@
+<?php
+
+/*
+ * Create and destroy proxies at a high rate.
+ */
+
+function churn_setup() {
+	$o = new stdClass;
+	$o->data = ["a" => ["b" => ["c" => 0]]];
+	return [$o];
+}
+
+return [
+	"root" => [
+		"ops" => 100000,
+		"setup" => "churn_setup",
+		"run" => function($state, $ops) {
+			list($o) = $state;
+			for ($i = 0; $i < $ops; ++$i) {
+				$p = new php\PropertyProxy($o, "data");
+			}
+		},
+	],
+	"children" => [
+		"ops" => 100000,
+		"setup" => "churn_setup",
+		"run" => function($state, $ops) {
+			list($o) = $state;
+			$p = new php\PropertyProxy($o, "data");
+			for ($i = 0; $i < $ops; ++$i) {
+				/* each level is a temporary child proxy */
+				$p["a"]["b"]["c"] = $i;
+			}
+		},
+	],
+];
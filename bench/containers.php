@@ -0,0 +1,64 @@
+<?php
+
+/*
+ * Write through proxies of the same member of different kinds of
+ * containers.
+ */
+
+class bench_declared {
+	public $data = [];
+}
+
+class bench_magic {
+	private $props = ["data" => []];
+	function __get($p) {
+		return $this->props[$p];
+	}
+	function __set($p, $v) {
+		$this->props[$p] = $v;
+	}
+}
+
+function containers_run($state, $ops) {
+	list(, $p) = $state;
+	for ($i = 0; $i < $ops; ++$i) {
+		$p["key"]["value"] = $i;
+	}
+}
+
+return [
+	"dynamic" => [
+		"ops" => 100000,
+		"setup" => function() {
+			$o = new stdClass;
+			$o->data = [];
+			return [$o, new php\PropertyProxy($o, "data")];
+		},
+		"run" => "containers_run",
+	],
+	"declared" => [
+		"ops" => 100000,
+		"setup" => function() {
+			$o = new bench_declared;
+			return [$o, new php\PropertyProxy($o, "data")];
+		},
+		"run" => "containers_run",
+	],
+	"magic" => [
+		"ops" => 100000,
+		"setup" => function() {
+			$o = new bench_magic;
+			return [$o, new php\PropertyProxy($o, "data")];
+		},
+		"run" => "containers_run",
+	],
+	"object" => [
+		"ops" => 100000,
+		"setup" => function() {
+			$o = new stdClass;
+			$o->data = new stdClass;
+			return [$o, new php\PropertyProxy($o, "data")];
+		},
+		"run" => "containers_run",
+	],
+];
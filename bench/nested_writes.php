@@ -0,0 +1,34 @@
+<?php
+
+/*
+ * Write through proxies of members nested at increasing depths.
+ */
+
+function nested_writes_setup($depth) {
+	return function() use($depth) {
+		$o = new stdClass;
+		$o->data = [];
+		$p = new php\PropertyProxy($o, "data");
+		for ($i = 1; $i < $depth; ++$i) {
+			$p = new php\PropertyProxy(null, "level$i", $p);
+		}
+		return [$o, $p];
+	};
+}
+
+function nested_writes_run($state, $ops) {
+	list(, $p) = $state;
+	for ($i = 0; $i < $ops; ++$i) {
+		$p["value"] = $i;
+	}
+}
+
+$cases = [];
+foreach ([1, 2, 4, 8, 16] as $depth) {
+	$cases["depth$depth"] = [
+		"ops" => 100000,
+		"setup" => nested_writes_setup($depth),
+		"run" => "nested_writes_run",
+	];
+}
+return $cases;
@@ -0,0 +1,43 @@
+<?php
+
+/*
+ * Read repeatedly through a proxy of a nested member, with and without
+ * caching the resolved value.
+ */
+
+function reads_setup($cache) {
+	return function() use($cache) {
+		$o = new stdClass;
+		$o->data = ["a" => ["b" => ["c" => range(1, 100)]]];
+		$p = new php\PropertyProxy($o, "data");
+		$p = new php\PropertyProxy(null, "a", $p);
+		$p = new php\PropertyProxy(null, "b", $p);
+		$p = new php\PropertyProxy(null, "c", $p);
+		if ($cache) {
+			$p->cache();
+		}
+		return [$o, $p];
+	};
+}
+
+function reads_run($state, $ops) {
+	list(, $p) = $state;
+	for ($i = 0; $i < $ops; ++$i) {
+		$p[$i % 100];
+		isset($p[$i % 100]);
+		count($p);
+	}
+}
+
+return [
+	"uncached" => [
+		"ops" => 100000,
+		"setup" => reads_setup(false),
+		"run" => "reads_run",
+	],
+	"cached" => [
+		"ops" => 100000,
+		"setup" => reads_setup(true),
+		"run" => "reads_run",
+	],
+];
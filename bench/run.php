@@ -0,0 +1,83 @@
+<?php
+
+/*
+ * Run a benchmark case and print its results as a JSON line, or list the
+ * available cases, if none is given:
+ *
+ *	php run.php [<workload>:<case> [<ops>]]
+ *
+ * Each case is meant to run in a process of its own, so that the peak
+ * memory usage is that of the case; `make bench` runs all cases this way.
+ */
+
+if (!extension_loaded("propro")) {
+	fprintf(STDERR, "The propro extension is not loaded\n");
+	exit(1);
+}
+
+function workloads() {
+	$workloads = [];
+	foreach (glob(__DIR__ . "/*.php") as $file) {
+		if ($file !== __FILE__) {
+			$workloads[basename($file, ".php")] = $file;
+		}
+	}
+	return $workloads;
+}
+
+function now() {
+	if (function_exists("hrtime")) {
+		return hrtime(true);
+	}
+	return (int) (microtime(true) * 1e9);
+}
+
+$workloads = workloads();
+
+if ($argc < 2) {
+	foreach ($workloads as $workload => $file) {
+		foreach (array_keys(include $file) as $case) {
+			printf("%s:%s\n", $workload, $case);
+		}
+	}
+	exit;
+}
+
+list($workload, $case) = explode(":", $argv[1], 2) + [null, null];
+if (!isset($workloads[$workload])) {
+	fprintf(STDERR, "Unknown workload: %s\n", $workload);
+	exit(1);
+}
+$cases = include $workloads[$workload];
+if (!isset($cases[$case])) {
+	fprintf(STDERR, "Unknown case: %s\n", $argv[1]);
+	exit(1);
+}
+
+$bench = $cases[$case];
+$ops = isset($argv[2]) ? (int) $argv[2] : $bench["ops"];
+$state = $bench["setup"]();
+
+gc_collect_cycles();
+$memory = memory_get_usage();
+$before = php\propro_stats();
+$start = now();
+
+$bench["run"]($state, $ops);
+
+$ns = now() - $start;
+$after = php\propro_stats();
+
+$result = [
+	"case" => $argv[1],
+	"ops" => $ops,
+	"ns_per_op" => round($ns / $ops, 1),
+	"memory" => memory_get_usage() - $memory,
+	"peak_memory" => memory_get_peak_usage(),
+];
+/* PHP does not count allocations, but the counters of the proxies do */
+foreach (["proxies_created", "allocations", "separations", "separated_bytes", "writebacks", "key_conversions"] as $stat) {
+	$result[$stat] = $after[$stat] - $before[$stat];
+}
+
+echo json_encode($result), "\n";
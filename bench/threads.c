@@ -0,0 +1,179 @@
+/*
+    +--------------------------------------------------------------------+
+    | PECL :: propro                                                     |
+    +--------------------------------------------------------------------+
+    | Redistribution and use in source and binary forms, with or without |
+    | modification, are permitted provided that the conditions mentioned |
+    | in the accompanying LICENSE file are met.                          |
+    +--------------------------------------------------------------------+
+    | Copyright (c) 2013 Michael Wallner <mike@php.net>                  |
+    +--------------------------------------------------------------------+
+*/
+
+/*
+ * Run the same proxy workload in requests of concurrent threads of the
+ * embed SAPI and print the throughput for each number of threads as a
+ * JSON line:
+ *
+ *	PHPRC=<dir of php.ini loading propro> threads [<threads>...]
+ *
+ * Needs a thread-safe PHP built with --enable-embed; see `make bench-threads`.
+ */
+
+#include <pthread.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+
+#include <sapi/embed/php_embed.h>
+
+#ifndef ZTS
+#	error "the thread stress benchmark needs a thread-safe PHP"
+#endif
+
+#define BENCH_OPS 100000
+
+static const char bench_script[] =
+	"$o = new stdClass;\n"
+	"$o->data = ['list' => []];\n"
+	"$p = new php\\PropertyProxy($o, 'data');\n"
+	"for ($i = 0; $i < " ZEND_TOSTR(BENCH_OPS) "; ++$i) {\n"
+	"	$p['list'][$i % 100] = $i;\n"
+	"	$p['a']['b']['c'] = $p['list'][$i % 100];\n"
+	"	$q = new php\\PropertyProxy($o, 'data');\n"
+	"	$q['x'] = count($q['list']);\n"
+	"}\n";
+
+static pthread_barrier_t bench_start, bench_done;
+
+static double now(void)
+{
+	struct timespec ts;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+static void *bench_thread(void *arg)
+{
+	int *failed = arg;
+
+	(void) ts_resource(0);
+	ZEND_TSRMLS_CACHE_UPDATE();
+
+	SG(options) |= SAPI_OPTION_NO_CHDIR;
+	SG(headers_sent) = 1;
+	SG(request_info).no_headers = 1;
+
+	if (SUCCESS != php_request_startup()) {
+		*failed = 1;
+		pthread_barrier_wait(&bench_start);
+		pthread_barrier_wait(&bench_done);
+		ts_free_thread();
+		return NULL;
+	}
+
+	pthread_barrier_wait(&bench_start);
+	zend_try {
+		if (SUCCESS != zend_eval_stringl((char *) bench_script,
+				sizeof(bench_script) - 1, NULL, (char *) "propro bench")) {
+			*failed = 1;
+		}
+	} zend_catch {
+		*failed = 1;
+	} zend_end_try();
+	pthread_barrier_wait(&bench_done);
+
+	php_request_shutdown(NULL);
+	ts_free_thread();
+
+	return NULL;
+}
+
+static int bench(int threads, double *elapsed)
+{
+	pthread_t *tids = calloc(threads, sizeof(*tids));
+	int *failed = calloc(threads, sizeof(*failed));
+	int i, rc = SUCCESS;
+	double start;
+
+	pthread_barrier_init(&bench_start, NULL, threads + 1);
+	pthread_barrier_init(&bench_done, NULL, threads + 1);
+
+	for (i = 0; i < threads; ++i) {
+		pthread_create(&tids[i], NULL, bench_thread, &failed[i]);
+	}
+	pthread_barrier_wait(&bench_start);
+	start = now();
+	pthread_barrier_wait(&bench_done);
+	*elapsed = now() - start;
+
+	for (i = 0; i < threads; ++i) {
+		pthread_join(tids[i], NULL);
+		if (failed[i]) {
+			rc = FAILURE;
+		}
+	}
+
+	pthread_barrier_destroy(&bench_start);
+	pthread_barrier_destroy(&bench_done);
+	free(failed);
+	free(tids);
+
+	return rc;
+}
+
+int main(int argc, char *argv[])
+{
+	static char *defaults[] = {NULL, "1", "2", "4", "8"};
+	double base = 0;
+	int i;
+
+	if (argc < 2) {
+		argc = sizeof(defaults) / sizeof(*defaults);
+		argv = defaults;
+	}
+
+	PHP_EMBED_START_BLOCK(0, NULL)
+
+	if (!zend_hash_str_exists(&module_registry, "propro", sizeof("propro") - 1)) {
+		fprintf(stderr, "The propro extension is not loaded, check PHPRC\n");
+		exit(1);
+	}
+
+	for (i = 1; i < argc; ++i) {
+		int threads = atoi(argv[i]);
+		double elapsed, rate;
+
+		if (threads < 1) {
+			continue;
+		}
+		if (SUCCESS != bench(threads, &elapsed)) {
+			fprintf(stderr, "The workload failed with %d threads\n", threads);
+			exit(1);
+		}
+
+		rate = threads * BENCH_OPS / elapsed;
+		if (!base) {
+			base = rate / threads;
+		}
+		printf("{\"threads\":%d,\"ops\":%d,\"seconds\":%.3f,"
+				"\"ops_per_second\":%.0f,\"speedup\":%.2f}\n",
+				threads, threads * BENCH_OPS, elapsed, rate, rate / base);
+		fflush(stdout);
+	}
+
+	PHP_EMBED_END_BLOCK()
+
+	return 0;
+}
+
+
+/*
+ * Local variables:
+ * tab-width: 4
+ * c-basic-offset: 4
+ * End:
+ * vim600: noet sw=4 ts=4 fdm=marker
+ * vim<600: noet sw=4 ts=4
+ */
@@ -1,5 +1,7 @@
 PHP_ARG_ENABLE(propro, whether to enable property proxy support,
 [  --enable-propro         Enable property proxy support])
+PHP_ARG_ENABLE(propro-test, whether to build the property proxy test class,
+[  --enable-propro-test    Build php\\PropertyProxyTest for the test suite], no, no)
 
 if test "$PHP_PROPRO" != "no"; then
 	PHP_PROPRO_SRCDIR=PHP_EXT_SRCDIR(propro)
@@ -11,7 +13,14 @@ if test "$PHP_PROPRO" != "no"; then
 	PHP_PROPRO_HEADERS=`(cd $PHP_PROPRO_SRCDIR/src && echo *.h)`
 	PHP_PROPRO_SOURCES=`(cd $PHP_PROPRO_SRCDIR && echo src/*.c)`
 
+	if test "$PHP_PROPRO_TEST" = "yes"; then
+		AC_DEFINE(PHP_PROPRO_TEST, 1, [Have php\\PropertyProxyTest])
+	else
+		PHP_PROPRO_SOURCES=`echo $PHP_PROPRO_SOURCES | $SED -e 's#src/php_propro_test\.c##'`
+	fi
+
 	PHP_NEW_EXTENSION(propro, $PHP_PROPRO_SOURCES, $ext_shared)
+	PHP_ADD_EXTENSION_DEP(propro, json)
 	PHP_INSTALL_HEADERS(ext/propro, php_propro.h $PHP_PROPRO_HEADERS)
 
 	PHP_SUBST(PHP_PROPRO_HEADERS)
@@ -20,5 +29,9 @@ if test "$PHP_PROPRO" != "no"; then
 	PHP_SUBST(PHP_PROPRO_SRCDIR)
 	PHP_SUBST(PHP_PROPRO_BUILDDIR)
 
+	dnl the php-config of phpize builds, for the embed SAPI of bench-threads
+	PHP_PROPRO_PHP_CONFIG=${PHP_CONFIG:-php-config}
+	PHP_SUBST(PHP_PROPRO_PHP_CONFIG)
+
 	PHP_ADD_MAKEFILE_FRAGMENT
 fi
@@ -16,7 +16,14 @@
 extern zend_module_entry propro_module_entry;
 #define phpext_propro_ptr &propro_module_entry
 
-#define PHP_PROPRO_VERSION "2.1.0"
+/*
+ * 3.0.0 breaks the ABI of 2.x: php_property_proxy_t resolves nested members
+ * through the flat path of keys from the root container instead of a parent
+ * proxy, its member is NULL for integer keys, and php_property_proxy_object_t
+ * does not embed the proxy anymore. Extensions using the API need to be
+ * rebuilt against it.
+ */
+#define PHP_PROPRO_VERSION "3.0.0"
 
 #ifdef PHP_WIN32
 #	define PHP_PROPRO_API __declspec(dllexport)
@@ -17,22 +17,138 @@
 
 #include <php.h>
 #include <ext/standard/info.h>
+#include <ext/standard/basic_functions.h>
+#include <ext/standard/php_var.h>
+#include <ext/json/php_json.h>
+#include <zend_interfaces.h>
+#if PHP_VERSION_ID >= 70400
+#	include <zend_weakrefs.h>
+#endif
 
 #include "php_propro_api.h"
 
 #define DEBUG_PROPRO 0
 
+/* the maximum number of entries kept in a free list */
+#define PROPRO_POOL_MAX 64
+/* the capacities of pooled key vectors are PROPRO_PATH_POOL_MIN << n */
+#define PROPRO_PATH_POOL_MIN 8
+#define PROPRO_PATH_POOLS 3
+/* the number of run-time cache entries for object properties, a power of 2 */
+#define PROPRO_CACHE_SIZE 64
+/* the number of generation counters of root containers, a power of 2 */
+#define PROPRO_GENERATIONS 64
+/* the maximum number of interned child proxy objects of a proxy */
+#define PROPRO_CHILDREN_MAX 8
+/* the number of buckets of the path depth histogram, the last one is open */
+#define PROPRO_STATS_DEPTHS 8
+
+#if PHP_VERSION_ID >= 70300
+#	define PROPRO_HT_INITIALIZED(ht) (!(HT_FLAGS(ht) & HASH_FLAG_UNINITIALIZED))
+#else
+#	define PROPRO_HT_INITIALIZED(ht) ((ht)->u.flags & HASH_FLAG_INITIALIZED)
+#endif
+#define PROPRO_HT_PACKED(ht) ((ht)->u.flags & HASH_FLAG_PACKED)
+
+typedef struct php_propro_pool {
+	void *head;
+	uint32_t size;
+} php_propro_pool_t;
+
+typedef struct php_propro_cache {
+	zend_class_entry *ce;
+	zend_string *name;
+	/* the run-time cache slots the property handlers resolve into */
+	void *slot[3];
+} php_propro_cache_t;
+
+#if PHP_VERSION_ID >= 70400
+/* the layout of WeakReference objects, which zend_weakrefs.c keeps private */
+typedef struct php_propro_weakref {
+	zend_object *referent;
+	zend_object std;
+} php_propro_weakref_t;
+#endif
+
+typedef struct php_propro_stats {
+	zend_ulong proxies_created;
+	zend_ulong proxies_freed;
+	/* proxies, proxy objects and key vectors not recycled from a free list */
+	zend_ulong allocations;
+	/* arrays duplicated to make them writable, and their approximate size */
+	zend_ulong separations;
+	zend_ulong separated_bytes;
+	/* property values written back to objects without slots or native storage */
+	zend_ulong writebacks;
+	/* offsets converted to string keys or property names */
+	zend_ulong key_conversions;
+	/* the numbers of proxies created by their path depth */
+	zend_ulong depths[PROPRO_STATS_DEPTHS];
+} php_propro_stats_t;
+
+typedef struct php_propro_journal {
+	/* the root container, kept alive so that its address is not reused */
+	zval container;
+	/* the changed paths as lists of keys, keyed by their encoding */
+	HashTable changes;
+	/* the number of keys of the longest changed path */
+	uint32_t depth;
+} php_propro_journal_t;
+
+ZEND_BEGIN_MODULE_GLOBALS(propro)
+	/* request scoped free list of property proxies */
+	php_propro_pool_t proxies;
+	/* request scoped free lists of key vectors exceeding the inline keys */
+	php_propro_pool_t paths[PROPRO_PATH_POOLS];
+	/* request scoped property offsets of object containers */
+	php_propro_cache_t cache[PROPRO_CACHE_SIZE];
+	/* the property proxies in deferred write-back mode */
+	HashTable *deferred;
+	/* whether the shutdown function committing them has been registered */
+	zend_bool committing;
+	/* the generations of root containers, bumped by writes */
+	zend_ulong generations[PROPRO_GENERATIONS];
+	/* the property proxies in caching mode by the generation of their root */
+	HashTable *caching[PROPRO_GENERATIONS];
+	/* the numbers of cached values of the proxies above */
+	uint32_t cached[PROPRO_GENERATIONS];
+	/* the change journals of root containers */
+	HashTable *journals;
+	/* request scoped counters */
+	php_propro_stats_t stats;
+#if DEBUG_PROPRO
+	/* the nesting level of the trace */
+	int debug_level;
+#endif
+ZEND_END_MODULE_GLOBALS(propro)
+
+ZEND_DECLARE_MODULE_GLOBALS(propro);
+
+#define PROPRO_G(v) ZEND_MODULE_GLOBALS_ACCESSOR(propro, v)
+#define PROPRO_STAT(s) PROPRO_G(stats).s
+
+#if defined(ZTS) && defined(COMPILE_DL_PROPRO)
+ZEND_TSRMLS_CACHE_DEFINE();
+#endif
+
+struct php_property_proxy_deferred {
+	/** The reference to the buffered value of the proxied property */
+	zval buffer;
+	/** The value last read from or written back to the proxied property */
+	zval committed;
+};
+
 static inline php_property_proxy_object_t *get_propro(zval *object);
-static inline zval *get_proxied_value(zval *object, zval *return_value);
-static inline void set_proxied_value(zval *object, zval *value);
+static void end_deferred(php_property_proxy_t *proxy, zend_bool commit);
+static void end_caching(php_property_proxy_t *proxy);
+static zval *get_proxied_value(zval *object, zval *return_value);
+static void set_proxied_value(zval *object, zval *value);
 
 static zval *read_dimension(zval *object, zval *offset, int type, zval *return_value);
 static ZEND_RESULT_CODE cast_obj(zval *object, zval *return_value, int type);
 static void write_dimension(zval *object, zval *offset, zval *input_value);
 
 #if DEBUG_PROPRO
-/* we do not really care about TS when debugging */
-static int level = 1;
 static const char *inoutstr[] = {"< return","=       "," > enter "};
 static const char *types[] = {
 		"UNDEF",
@@ -72,44 +188,42 @@ static int _walk(php_property_proxy_object_t *obj)
 {
 	int p = 0;
 
-	if (obj) {
-		if (!Z_ISUNDEF(obj->parent)) {
-			p += _walk(get_propro(&obj->parent));
-		}
-		if (obj->proxy) {
-			p += fprintf(stderr, ".%s", obj->proxy->member->val);
+	if (obj && obj->proxy) {
+		uint32_t i;
+
+		for (i = 0; i < obj->proxy->depth; ++i) {
+			zval *key = &obj->proxy->path[i];
+
+			if (Z_TYPE_P(key) == IS_LONG) {
+				p += fprintf(stderr, "." ZEND_LONG_FMT, Z_LVAL_P(key));
+			} else {
+				p += fprintf(stderr, ".%s", Z_STRVAL_P(key));
+			}
 		}
 	}
 
 	return p;
 }
 
-static inline zval *get_container(zval *object, zval *tmp);
-static inline zval *get_container_value(zval *container, zend_string *member, zval *return_value);
-
 static void debug_propro(int inout, const char *f,
 		php_property_proxy_object_t *obj,
 		php_property_proxy_t *proxy,
 		zval *offset, zval *value)
 {
 	int width;
-	zval tmp, *container = &tmp;
+	zval *container;
 
 	if (!proxy && obj) {
 		proxy = obj->proxy;
 	}
 
-	fprintf(stderr, "#PP %14p %*c %s %s\t", proxy, level, ' ', inoutstr[inout + 1], f);
+	fprintf(stderr, "#PP %14p %*c %s %s\t", proxy, PROPRO_G(debug_level) + 1, ' ',
+			inoutstr[inout + 1], f);
 
-	level += inout;
+	PROPRO_G(debug_level) += inout;
 
 	if (proxy) {
-		ZVAL_UNDEF(&tmp);
-		if (!obj) {
-			container = &proxy->container;
-		} else if (Z_ISUNDEF(obj->parent)) {
-			container = &obj->proxy->container;
-		}
+		container = &proxy->container;
 		fprintf(stderr, " container= %-14p < %-10s rc=%-2d%s> ",
 				Z_REFCOUNTED_P(container) ? Z_COUNTED_P(container) : NULL,
 				_type(container),
@@ -159,56 +273,360 @@ static void debug_propro(int inout, const char *f,
 #define debug_propro(l, f, obj, proxy, off, val)
 #endif
 
-php_property_proxy_t *php_property_proxy_init(zval *container, zend_string *member)
+/*
+ * Normalize an offset to either an integer or a non-numeric string key,
+ * like the symtable API does.
+ */
+static inline void init_key(zval *key, zval *offset)
 {
-	php_property_proxy_t *proxy = ecalloc(1, sizeof(*proxy));
-#if DEBUG_PROPRO
-	zval offset;
+	zend_string *str;
+	zend_ulong idx;
 
-	ZVAL_STR_COPY(&offset, member);
-#endif
+	ZVAL_DEREF(offset);
+	switch (Z_TYPE_P(offset)) {
+	case IS_LONG:
+		ZVAL_LONG(key, Z_LVAL_P(offset));
+		return;
+
+	case IS_STRING:
+		str = zend_string_copy(Z_STR_P(offset));
+		break;
+
+	default:
+		str = zval_get_string(offset);
+		++PROPRO_STAT(key_conversions);
+		break;
+	}
+
+	if (ZEND_HANDLE_NUMERIC_STR(str, idx)) {
+		zend_string_release(str);
+		ZVAL_LONG(key, idx);
+	} else {
+		ZVAL_STR(key, str);
+	}
+}
+
+/*
+ * Get the property name of a key, which has to be released by the caller.
+ */
+static inline zend_string *get_key_name(zval *key)
+{
+	if (Z_TYPE_P(key) == IS_LONG) {
+		++PROPRO_STAT(key_conversions);
+		return zend_long_to_str(Z_LVAL_P(key));
+	}
+	return zend_string_copy(Z_STR_P(key));
+}
+
+static inline zval *find_key(HashTable *ht, zval *key)
+{
+	if (Z_TYPE_P(key) == IS_LONG) {
+		return zend_hash_index_find(ht, Z_LVAL_P(key));
+	}
+	return zend_hash_find(ht, Z_STR_P(key));
+}
+
+static inline void *pool_get(php_propro_pool_t *pool, size_t size)
+{
+	void *ptr = pool->head;
+
+	if (ptr) {
+		pool->head = *(void **) ptr;
+		--pool->size;
+		return ptr;
+	}
+	++PROPRO_STAT(allocations);
+	return emalloc(size);
+}
+
+static inline void pool_put(php_propro_pool_t *pool, void *ptr)
+{
+	if (pool->size < PROPRO_POOL_MAX) {
+		*(void **) ptr = pool->head;
+		pool->head = ptr;
+		++pool->size;
+	} else {
+		efree(ptr);
+	}
+}
+
+static inline void pool_drain(php_propro_pool_t *pool)
+{
+	while (pool->head) {
+		void *ptr = pool->head;
+
+		pool->head = *(void **) ptr;
+		efree(ptr);
+	}
+	pool->size = 0;
+}
 
+static inline int path_pool(uint32_t depth)
+{
+	int n;
+
+	for (n = 0; n < PROPRO_PATH_POOLS; ++n) {
+		if (depth <= (PROPRO_PATH_POOL_MIN << n)) {
+			return n;
+		}
+	}
+	return -1;
+}
+
+static inline zval *alloc_path(uint32_t depth)
+{
+	int n = path_pool(depth);
+
+	if (n < 0) {
+		return safe_emalloc(depth, sizeof(zval), 0);
+	}
+	return pool_get(&PROPRO_G(paths)[n], (PROPRO_PATH_POOL_MIN << n) * sizeof(zval));
+}
+
+static inline void free_path(zval *path, uint32_t depth)
+{
+	int n = path_pool(depth);
+
+	if (n < 0) {
+		efree(path);
+	} else {
+		pool_put(&PROPRO_G(paths)[n], path);
+	}
+}
+
+/*
+ * Initialize the storage of a property proxy for \a depth keys; the caller
+ * has to initialize the keys.
+ */
+static inline void init_proxy(php_property_proxy_t *proxy, zval *container,
+		uint32_t depth)
+{
 	if (container) {
 		ZVAL_COPY(&proxy->container, container);
+	} else {
+		ZVAL_UNDEF(&proxy->container);
+	}
+	ZVAL_UNDEF(&proxy->cached);
+	proxy->member = NULL;
+	proxy->deferred = NULL;
+	proxy->children = NULL;
+	proxy->ops = NULL;
+	proxy->data = NULL;
+	proxy->weakref = NULL;
+	proxy->generation = 0;
+	proxy->depth = depth;
+	proxy->caching = 0;
+	proxy->untracked = 0;
+
+	++PROPRO_STAT(proxies_created);
+	++PROPRO_STAT(depths)[MIN(depth, PROPRO_STATS_DEPTHS) - 1];
+	if (depth <= PHP_PROPRO_PATH_INLINE) {
+		proxy->path = proxy->path_inline;
+	} else {
+		proxy->path = alloc_path(depth);
 	}
-	proxy->member = zend_string_copy(member);
+}
 
-	debug_propro(0, "init", NULL, proxy, &offset, NULL);
+static inline void init_member(php_property_proxy_t *proxy, zval *offset)
+{
+	zval *key = &proxy->path[proxy->depth - 1];
 
-#if DEBUG_PROPRO
-	zval_dtor(&offset);
+	init_key(key, offset);
+	proxy->member = Z_TYPE_P(key) == IS_STRING ? Z_STR_P(key) : NULL;
+}
+
+/*
+ * Detach a proxy in weak mode from its container, if that has been freed;
+ * the proxy then proxies a property of NULL.
+ */
+static inline void check_weak(php_property_proxy_t *proxy)
+{
+#if PHP_VERSION_ID >= 70400
+	php_propro_weakref_t *wr;
+
+	if (proxy->weakref) {
+		wr = PHP_PROPRO_PTR(proxy->weakref);
+		if (!wr->referent) {
+			/* the proxy moves to the generation of NULL */
+			if (proxy->caching) {
+				end_caching(proxy);
+			}
+			OBJ_RELEASE(proxy->weakref);
+			proxy->weakref = NULL;
+			ZVAL_NULL(&proxy->container);
+		}
+	}
 #endif
+}
 
-	return proxy;
+static inline void init_proxy_child(php_property_proxy_t *proxy,
+		php_property_proxy_t *parent, zval *member)
+{
+	uint32_t i;
+
+	/* the buffer of a deferring parent stands in for the proxied property */
+	if (parent->deferred) {
+		init_proxy(proxy, &parent->deferred->buffer, 1);
+		init_member(proxy, member);
+		proxy->untracked = parent->untracked;
+		return;
+	}
+
+	check_weak(parent);
+	if (parent->weakref) {
+		/* share the WeakReference and borrow the container */
+		init_proxy(proxy, NULL, parent->depth + 1);
+		ZVAL_COPY_VALUE(&proxy->container, &parent->container);
+		proxy->weakref = parent->weakref;
+		GC_ADDREF(proxy->weakref);
+	} else {
+		init_proxy(proxy, &parent->container, parent->depth + 1);
+	}
+	proxy->untracked = parent->untracked;
+	proxy->ops = parent->ops;
+	proxy->data = parent->data;
+	for (i = 0; i < parent->depth; ++i) {
+		ZVAL_COPY(&proxy->path[i], &parent->path[i]);
+	}
+	init_member(proxy, member);
 }
 
-void php_property_proxy_free(php_property_proxy_t **proxy)
+static inline void free_children(php_property_proxy_t *proxy)
 {
-#if DEBUG_PROPRO
+	HashTable *children = proxy->children;
+
+	proxy->children = NULL;
+	zend_hash_destroy(children);
+	FREE_HASHTABLE(children);
+}
+
+static inline void dtor_proxy(php_property_proxy_t *proxy)
+{
+	zend_bool weak = proxy->weakref != NULL;
+	uint32_t i;
+
+	/* detach from the container of a weak proxy before looking at it */
+	check_weak(proxy);
+	if (proxy->deferred) {
+		zend_bool commit = 1;
+
+		/* the container might have been freed already, either since it was
+		 * weakly referenced or by the garbage collector */
+		if (weak && !proxy->weakref) {
+			commit = 0;
+		} else if (Z_TYPE(proxy->container) == IS_OBJECT
+		&&	(GC_FLAGS(Z_OBJ(proxy->container)) & IS_OBJ_FREE_CALLED)) {
+			commit = 0;
+		}
+		end_deferred(proxy, commit);
+	}
+	if (proxy->caching) {
+		end_caching(proxy);
+	}
+	if (proxy->children) {
+		free_children(proxy);
+	}
+	if (proxy->weakref) {
+		/* the container is borrowed */
+		OBJ_RELEASE(proxy->weakref);
+		proxy->weakref = NULL;
+		ZVAL_UNDEF(&proxy->container);
+	} else if (!Z_ISUNDEF(proxy->container)) {
+		zval_ptr_dtor(&proxy->container);
+		ZVAL_UNDEF(&proxy->container);
+	}
+	for (i = 0; i < proxy->depth; ++i) {
+		zval_ptr_dtor(&proxy->path[i]);
+	}
+	if (proxy->path != proxy->path_inline) {
+		free_path(proxy->path, proxy->depth);
+	}
+	proxy->path = NULL;
+	proxy->depth = 0;
+	proxy->member = NULL;
+
+	++PROPRO_STAT(proxies_freed);
+}
+
+php_property_proxy_t *php_property_proxy_init(zval *container, zend_string *member)
+{
+	php_property_proxy_t *proxy = pool_get(&PROPRO_G(proxies), sizeof(*proxy));
 	zval offset;
 
-	ZVAL_STR_COPY(&offset, (*proxy)->member);
-	debug_propro(0, "free", NULL, *proxy, &offset, NULL);
-#endif
+	init_proxy(proxy, container, 1);
+	ZVAL_STR(&offset, member);
+	init_member(proxy, &offset);
+
+	debug_propro(0, "init", NULL, proxy, NULL, NULL);
+
+	return proxy;
+}
+
+php_property_proxy_t *php_property_proxy_init_ops(zval *container,
+		zend_string *member, const php_property_proxy_ops_t *ops, void *data)
+{
+	php_property_proxy_t *proxy = php_property_proxy_init(container, member);
+
+	proxy->ops = ops;
+	proxy->data = data;
+
+	return proxy;
+}
+
+php_property_proxy_t *php_property_proxy_init_child(php_property_proxy_t *parent,
+		zval *member)
+{
+	php_property_proxy_t *proxy = pool_get(&PROPRO_G(proxies), sizeof(*proxy));
+
+	init_proxy_child(proxy, parent, member);
+
+	debug_propro(0, "init", NULL, proxy, NULL, NULL);
+
+	return proxy;
+}
 
+void php_property_proxy_free(php_property_proxy_t **proxy)
+{
 	if (*proxy) {
-		if (!Z_ISUNDEF((*proxy)->container)) {
-			zval_ptr_dtor(&(*proxy)->container);
-			ZVAL_UNDEF(&(*proxy)->container);
-		}
-		zend_string_release((*proxy)->member);
-		(*proxy)->member = NULL;
-		efree(*proxy);
+		debug_propro(0, "free", NULL, *proxy, NULL, NULL);
+
+		dtor_proxy(*proxy);
+		pool_put(&PROPRO_G(proxies), *proxy);
 		*proxy = NULL;
 	}
-
-#if DEBUG_PROPRO
-	zval_dtor(&offset);
-#endif
 }
 
+/*
+ * php\PropertyProxy objects created along with their property proxy, i.e.
+ * by new, unserialize() and child access, carry its storage in front of
+ * them; objects wrapping a property proxy created elsewhere do not.
+ */
+typedef struct php_propro_object_ex {
+	php_property_proxy_t storage;
+	php_property_proxy_object_t obj;
+} php_propro_object_ex_t;
+
+/* set up once by MINIT, read-only for all threads afterwards */
 static zend_class_entry *php_property_proxy_class_entry;
 static zend_object_handlers php_property_proxy_object_handlers;
+static zend_object_handlers php_property_proxy_storage_handlers;
+static zend_class_entry *php_property_path_class_entry;
+static zend_object_handlers php_property_path_object_handlers;
+
+/*
+ * Keep a proxy object out of the root buffer of the cycle collector, or
+ * let it in again; earlier versions of PHP decide this by the type only.
+ */
+static inline void untrack_object(zend_object *zo, zend_bool untrack)
+{
+#if PHP_VERSION_ID >= 70300
+	if (untrack) {
+		GC_DEL_FLAGS(zo, GC_COLLECTABLE);
+	} else {
+		GC_ADD_FLAGS(zo, GC_COLLECTABLE);
+	}
+#endif
+}
 
 zend_class_entry *php_property_proxy_get_class_entry(void)
 {
@@ -224,73 +642,202 @@ php_property_proxy_object_t *php_property_proxy_object_new_ex(
 		ce = php_property_proxy_class_entry;
 	}
 
-	o = ecalloc(1, sizeof(*o) + sizeof(zval) * (ce->default_properties_count - 1));
+	o = emalloc(sizeof(*o) + sizeof(zval) * (ce->default_properties_count - 1));
+	++PROPRO_STAT(allocations);
 	zend_object_std_init(&o->zo, ce);
 	object_properties_init(&o->zo, ce);
 
 	o->proxy = proxy;
 	o->zo.handlers = &php_property_proxy_object_handlers;
+	if (proxy && proxy->untracked) {
+		untrack_object(&o->zo, 1);
+	}
 
 	return o;
 }
 
+/*
+ * Instantiate a php\PropertyProxy with the storage of its property proxy in
+ * the same allocation; the caller initializes it.
+ */
+static php_property_proxy_object_t *new_storage_object(zend_class_entry *ce)
+{
+	php_propro_object_ex_t *ex;
+
+	ex = emalloc(sizeof(*ex) + sizeof(zval) * (ce->default_properties_count - 1));
+	++PROPRO_STAT(allocations);
+	zend_object_std_init(&ex->obj.zo, ce);
+	object_properties_init(&ex->obj.zo, ce);
+
+	ex->obj.proxy = NULL;
+	ex->obj.zo.handlers = &php_property_proxy_storage_handlers;
+
+	return &ex->obj;
+}
+
+static inline php_property_proxy_t *get_storage(php_property_proxy_object_t *o)
+{
+	ZEND_ASSERT(o->zo.handlers == &php_property_proxy_storage_handlers);
+	return &((php_propro_object_ex_t *) PHP_PROPRO_PTR(&o->zo))->storage;
+}
+
 zend_object *php_property_proxy_object_new(zend_class_entry *ce)
 {
-	return &php_property_proxy_object_new_ex(ce, NULL)->zo;
+	return &new_storage_object(ce)->zo;
+}
+
+/*
+ * Instantiate a new php\PropertyProxy for \a member of the property proxied
+ * by \a parent with a single allocation.
+ */
+static php_property_proxy_object_t *new_child_object(php_property_proxy_t *parent,
+		zval *member)
+{
+	php_property_proxy_object_t *o = new_storage_object(php_property_proxy_class_entry);
+
+	init_proxy_child(get_storage(o), parent, member);
+	o->proxy = get_storage(o);
+	if (o->proxy->untracked) {
+		untrack_object(&o->zo, 1);
+	}
+
+	return o;
+}
+
+/*
+ * Get the interned php\PropertyProxy for \a offset of the property proxied
+ * by \a parent, or instantiate and intern a new one. Child objects, which
+ * have been switched to deferred or caching mode, are not shared.
+ */
+static zend_object *get_child_object(php_property_proxy_t *parent, zval *offset)
+{
+	php_property_proxy_object_t *o;
+	zval key, *found, zo;
+
+	init_key(&key, offset);
+
+	if (parent->children && (found = find_key(parent->children, &key))) {
+		o = get_propro(found);
+		if (!o->proxy->deferred && !o->proxy->caching) {
+			zval_ptr_dtor(&key);
+			Z_ADDREF_P(found);
+			return Z_OBJ_P(found);
+		}
+		if (Z_TYPE(key) == IS_LONG) {
+			zend_hash_index_del(parent->children, Z_LVAL(key));
+		} else {
+			zend_hash_del(parent->children, Z_STR(key));
+		}
+	}
+
+	o = new_child_object(parent, &key);
+
+	if (!parent->children) {
+		ALLOC_HASHTABLE(parent->children);
+		zend_hash_init(parent->children, PROPRO_CHILDREN_MAX, NULL,
+				ZVAL_PTR_DTOR, 0);
+	}
+	if (zend_hash_num_elements(parent->children) < PROPRO_CHILDREN_MAX) {
+		ZVAL_OBJ(&zo, &o->zo);
+		Z_ADDREF(zo);
+		if (Z_TYPE(key) == IS_LONG) {
+			zend_hash_index_update(parent->children, Z_LVAL(key), &zo);
+		} else {
+			zend_hash_update(parent->children, Z_STR(key), &zo);
+		}
+	}
+	zval_ptr_dtor(&key);
+
+	return &o->zo;
 }
 
 static void destroy_obj(zend_object *object)
 {
-	php_property_proxy_object_t *o = PHP_PROPRO_PTR(object);
+	php_property_proxy_object_t *o = PHP_PROPRO_OBJECT(object);
 
-	if (o->proxy) {
+	if (object->handlers == &php_property_proxy_storage_handlers
+	&&	o->proxy == get_storage(o)) {
+		dtor_proxy(o->proxy);
+		o->proxy = NULL;
+	} else if (o->proxy) {
 		php_property_proxy_free(&o->proxy);
 	}
-	if (!Z_ISUNDEF(o->parent)) {
-		zval_ptr_dtor(&o->parent);
-		ZVAL_UNDEF(&o->parent);
-	}
 	zend_object_std_dtor(object);
 }
 
 static inline php_property_proxy_object_t *get_propro(zval *object)
 {
 	ZEND_ASSERT(Z_TYPE_P(object) == IS_OBJECT);
-	return PHP_PROPRO_PTR(Z_OBJ_P(object));
+	return PHP_PROPRO_OBJECT(Z_OBJ_P(object));
+}
+
+/*
+ * Get the proxy of a native property, whose ops may directly be used.
+ */
+static inline php_property_proxy_t *get_native_proxy(zval *object)
+{
+	php_property_proxy_t *proxy = get_propro(object)->proxy;
+
+	if (proxy && proxy->ops && proxy->depth == 1 && !proxy->deferred) {
+		return proxy;
+	}
+	return NULL;
 }
 
 static HashTable *get_gc(zval *object, zval **table, int *n)
 {
 	php_property_proxy_object_t *o = get_propro(object);
 
-	if (Z_ISUNDEF(o->parent)) {
-		*table = &o->proxy->container;
+	if (!o->proxy) {
+		*table = NULL;
+		*n = 0;
+		return NULL;
+	}
+
+	/* the container of a weak proxy is borrowed */
+	if (o->proxy->weakref) {
+		ZVAL_UNDEF(&o->gc[0]);
 	} else {
-		*table = &o->parent;
+		ZVAL_COPY_VALUE(&o->gc[0], &o->proxy->container);
 	}
-	*n = 1;
-	return NULL;
+	ZVAL_COPY_VALUE(&o->gc[1], &o->proxy->cached);
+	*table = o->gc;
+	*n = 2;
+	return o->proxy->children;
 }
 
 static HashTable *get_debug_info(zval *object, int *is_temp)
 {
 	HashTable *ht;
-	zval *zmember;
+	zval *zmember, zpath;
 	php_property_proxy_object_t *obj = get_propro(object);
+	uint32_t i;
 
 	ALLOC_HASHTABLE(ht);
-	zend_hash_init(ht, 3, NULL, NULL, 0);
+	zend_hash_init(ht, 3, NULL, ZVAL_PTR_DTOR, 0);
 
-	if (Z_ISUNDEF(obj->parent)) {
-		zend_hash_str_add_empty_element(ht, "parent", sizeof("parent")-1);
+	if (!obj->proxy) {
+		*is_temp = 1;
+		return ht;
+	}
+
+	check_weak(obj->proxy);
+	/* compiled paths do not have a container */
+	if (!Z_ISUNDEF(obj->proxy->container)) {
+		Z_TRY_ADDREF(obj->proxy->container);
 		zend_hash_str_add(ht, "container", sizeof("container")-1, &obj->proxy->container);
-	} else {
-		zend_hash_str_add(ht, "parent", sizeof("parent")-1, &obj->parent);
-		zend_hash_str_add_empty_element(ht, "container", sizeof("container")-1);
 	}
 
-	zmember = zend_hash_str_add_empty_element(ht, "member", sizeof("member")-1);
-	ZVAL_STR(zmember, obj->proxy->member);
+	zmember = &obj->proxy->path[obj->proxy->depth - 1];
+	Z_TRY_ADDREF_P(zmember);
+	zend_hash_str_add(ht, "member", sizeof("member")-1, zmember);
+
+	array_init_size(&zpath, obj->proxy->depth);
+	for (i = 0; i < obj->proxy->depth; ++i) {
+		Z_TRY_ADDREF(obj->proxy->path[i]);
+		add_next_index_zval(&zpath, &obj->proxy->path[i]);
+	}
+	zend_hash_str_add(ht, "path", sizeof("path")-1, &zpath);
 
 	*is_temp = 1;
 	return ht;
@@ -298,10 +845,8 @@ static HashTable *get_debug_info(zval *object, int *is_temp)
 
 static ZEND_RESULT_CODE cast_obj(zval *object, zval *return_value, int type)
 {
-	zval tmp;
-
-	ZVAL_UNDEF(&tmp);
-	RETVAL_ZVAL(get_proxied_value(object, &tmp), 1, 0);
+	ZVAL_UNDEF(return_value);
+	get_proxied_value(object, return_value);
 
 	debug_propro(0, "cast", get_propro(object), NULL, NULL, return_value);
 
@@ -316,48 +861,107 @@ static ZEND_RESULT_CODE cast_obj(zval *object, zval *return_value, int type)
 
 static zval *get_obj(zval *object, zval *return_value)
 {
-	zval tmp;
-
-	ZVAL_UNDEF(&tmp);
-	RETVAL_ZVAL(get_proxied_value(object, &tmp), 1, 0);
-	return return_value;
+	ZVAL_UNDEF(return_value);
+	return get_proxied_value(object, return_value);
 }
 
 static void set_obj(zval *object, zval *value) {
 	set_proxied_value(object, value);
 }
 
-static inline zval *get_container(zval *object, zval *tmp)
+static inline zend_class_entry *swap_scope(zend_class_entry *scope)
 {
-	php_property_proxy_object_t *obj = get_propro(object);
-	zval *container;
+	zend_class_entry *prev;
 
-	if (Z_ISUNDEF(obj->parent)) {
-		container = &obj->proxy->container;
-	} else {
-		container = get_proxied_value(&obj->parent, tmp);
+#if PHP_VERSION_ID < 70100
+	prev = EG(scope);
+	EG(scope) = scope;
+#else
+	prev = EG(fake_scope);
+	EG(fake_scope) = scope;
+#endif
+	return prev;
+}
+
+/*
+ * Get the run-time cache slots of property \a name of class \a ce, which
+ * the property handlers fill like the ones of an opline, so the property
+ * info is only looked up once per request and (class, member).
+ */
+static inline void **get_cache_slot(zend_class_entry *ce, zend_string *name)
+{
+	zend_ulong h = zend_string_hash_val(name) ^ (((zend_uintptr_t) ce) >> 3);
+	php_propro_cache_t *entry = &PROPRO_G(cache)[h & (PROPRO_CACHE_SIZE - 1)];
+
+	if (entry->ce != ce || !entry->name || !zend_string_equals(entry->name, name)) {
+		if (entry->name) {
+			zend_string_release(entry->name);
+		}
+		entry->ce = ce;
+		entry->name = zend_string_copy(name);
+		memset(entry->slot, 0, sizeof(entry->slot));
 	}
-	return container;
+	return entry->slot;
 }
 
-static inline void set_container(zval *object, zval *container)
+/*
+ * Get the initialized declared property of \a zobj, which \a cache_slot
+ * resolved to, or NULL.
+ */
+static inline zval *get_cached_prop(zend_object *zobj, void **cache_slot)
 {
-	php_property_proxy_object_t *obj = get_propro(object);
+	if (cache_slot[0] == zobj->ce) {
+		zend_uintptr_t offset = (zend_uintptr_t) cache_slot[1];
 
-	if (Z_ISUNDEF(obj->parent)) {
-		if (container != &obj->proxy->container) {
-			zval tmp;
+		if (IS_VALID_PROPERTY_OFFSET(offset)) {
+			zval *prop = OBJ_PROP(zobj, offset);
 
-			ZVAL_COPY_VALUE(&tmp, &obj->proxy->container);
-			ZVAL_COPY(&obj->proxy->container, container);
-			zval_ptr_dtor(&tmp);
+			if (!Z_ISUNDEF_P(prop)) {
+				return prop;
+			}
 		}
-	} else {
-		set_proxied_value(&obj->parent, container);
 	}
+	return NULL;
+}
+
+static inline zval *read_object_property(zval *object, zval *key, zval *rv)
+{
+	zend_object *zobj = Z_OBJ_P(object);
+	zend_string *name = get_key_name(key);
+	void **cache_slot = get_cache_slot(zobj->ce, name);
+	zval zmember, *value = NULL;
+
+	if (zobj->handlers->read_property == zend_std_read_property) {
+		value = get_cached_prop(zobj, cache_slot);
+	}
+	if (!value) {
+		zend_class_entry *scope = swap_scope(zobj->ce);
+
+		ZVAL_STR(&zmember, name);
+		value = zobj->handlers->read_property(object, &zmember, BP_VAR_R,
+				cache_slot, rv);
+		swap_scope(scope);
+	}
+	zend_string_release(name);
+
+	return value;
 }
 
-static inline zval *get_container_value(zval *container, zend_string *member, zval *return_value)
+static inline void write_object_property(zval *object, zval *key, zval *value)
+{
+	zend_object *zobj = Z_OBJ_P(object);
+	zend_string *name = get_key_name(key);
+	zend_class_entry *scope = swap_scope(zobj->ce);
+	zval zmember;
+
+	ZVAL_STR(&zmember, name);
+	zobj->handlers->write_property(object, &zmember, value,
+			get_cache_slot(zobj->ce, name));
+	swap_scope(scope);
+	zend_string_release(name);
+}
+
+static inline zval *get_container_value(zval *container, zval *key, zval *return_value)
 {
 	zval *found_value = NULL, prop_tmp;
 
@@ -365,67 +969,177 @@ static inline zval *get_container_value(zval *container, zend_string *member, zv
 	switch (Z_TYPE_P(container)) {
 	case IS_OBJECT:
 		ZVAL_UNDEF(&prop_tmp);
-		found_value = zend_read_property(Z_OBJCE_P(container), container,
-				member->val, member->len, 0, &prop_tmp);
+		found_value = read_object_property(container, key, &prop_tmp);
 		break;
 
 	case IS_ARRAY:
-		found_value = zend_symtable_find(Z_ARRVAL_P(container), member);
+		found_value = find_key(Z_ARRVAL_P(container), key);
 		break;
 	}
 
 	if (found_value) {
-		RETVAL_ZVAL(found_value, 0, 0);
+		ZVAL_DEREF(found_value);
+		ZVAL_COPY(return_value, found_value);
+	}
+	if (Z_TYPE_P(container) == IS_OBJECT) {
+		zval_ptr_dtor(&prop_tmp);
 	}
 
 	return return_value;
 }
 
-static inline void cleanup_container(zval *object, zval *container, zend_bool separated)
-{
-	if (separated) {
-		zval_ptr_dtor(container);
-	}
-}
-
-static inline zend_bool separate_container(zval *object, zval *container)
+/*
+ * Make the value of a slot owned by its holder writable, converting it to
+ * an array, unless it already is an array or object.
+ */
+static inline zval *separate_slot(zval *slot)
 {
-	switch (Z_TYPE_P(container)) {
+	ZVAL_DEREF(slot);
+	switch (Z_TYPE_P(slot)) {
 	case IS_OBJECT:
-		return 0;
+		break;
 
 	case IS_ARRAY:
-		/* always duplicate for PHP-7.0 and 7.1 on travis */
-		ZVAL_ARR(container, zend_array_dup(Z_ARRVAL_P(container)));
+		if (Z_REFCOUNT_P(slot) > 1) {
+			++PROPRO_STAT(separations);
+			PROPRO_STAT(separated_bytes) += sizeof(HashTable)
+					+ HT_USED_SIZE(Z_ARRVAL_P(slot));
+		}
+		SEPARATE_ARRAY(slot);
 		break;
 
 	case IS_UNDEF:
-		array_init(container);
+	case IS_NULL:
+		array_init(slot);
 		break;
 
 	default:
-		SEPARATE_ZVAL(container);
-		Z_TRY_ADDREF_P(container);
-		convert_to_array(container);
+		convert_to_array(slot);
 		break;
 	}
 
-	return 1;
+	return slot;
+}
+
+/*
+ * Make room for \a n more elements in \a ht at once. A packed table is
+ * converted to a hash, unless \a packed, and a hash stays a hash.
+ */
+static inline void reserve_array(HashTable *ht, uint32_t n, zend_bool packed)
+{
+	uint32_t size = ht->nNumUsed;
+
+	size += MIN(n, HT_MAX_SIZE - 1 - size);
+
+	if (PROPRO_HT_INITIALIZED(ht)) {
+		if (!PROPRO_HT_PACKED(ht)) {
+			packed = 0;
+		} else if (!packed) {
+			zend_hash_packed_to_hash(ht);
+		}
+	}
+	zend_hash_extend(ht, size, packed);
+}
+
+/*
+ * Find or add the slot of \a key in an array container.
+ */
+static inline zval *get_array_slot(zval *container, zval *key)
+{
+	HashTable *ht = Z_ARRVAL_P(container);
+	zval *slot = find_key(ht, key);
+
+	if (!slot) {
+		if (Z_TYPE_P(key) == IS_LONG) {
+			slot = zend_hash_index_add_new(ht, Z_LVAL_P(key), &EG(uninitialized_zval));
+		} else {
+			slot = zend_hash_add_new(ht, Z_STR_P(key), &EG(uninitialized_zval));
+		}
+	}
+
+	return slot;
+}
+
+/*
+ * Find the slot of \a key in an object container, which can directly be
+ * written to, or NULL if the storage of the property is not zval backed.
+ */
+static inline zval *get_object_slot(zval *container, zval *key)
+{
+	zend_object *zobj = Z_OBJ_P(container);
+	const zend_object_handlers *handlers = zobj->handlers;
+	zend_class_entry *scope;
+	zend_string *name;
+	void **cache_slot;
+	zval zmember, *slot;
+
+	if (!handlers->get_property_ptr_ptr) {
+		return NULL;
+	}
+	/* custom property handlers might hide their storage behind std slots */
+	if (handlers->get_property_ptr_ptr == zend_std_get_property_ptr_ptr
+	&&	(handlers->read_property != zend_std_read_property
+	||	handlers->write_property != zend_std_write_property)) {
+		return NULL;
+	}
+#if PHP_VERSION_ID >= 70400
+	/* let the write handler verify typed properties */
+	if (ZEND_CLASS_HAS_TYPE_HINTS(zobj->ce)) {
+		return NULL;
+	}
+#endif
+
+	name = get_key_name(key);
+	cache_slot = get_cache_slot(zobj->ce, name);
+	if (handlers->get_property_ptr_ptr == zend_std_get_property_ptr_ptr
+	&&	(slot = get_cached_prop(zobj, cache_slot))) {
+		zend_string_release(name);
+		return slot;
+	}
+
+	ZVAL_STR(&zmember, name);
+	scope = swap_scope(zobj->ce);
+	slot = handlers->get_property_ptr_ptr(container, &zmember, BP_VAR_W, cache_slot);
+	swap_scope(scope);
+	zend_string_release(name);
+
+	if (!slot || slot == &EG(error_zval)) {
+		return NULL;
+	}
+	if (Z_ISUNDEF_P(slot)) {
+		ZVAL_NULL(slot);
+	}
+	return slot;
 }
 
-static inline zval *set_container_value(zval *container, zend_string *member, zval *value)
+static inline zval *set_container_value(zval *container, zval *key, zval *value)
 {
 	ZVAL_DEREF(container);
+	ZVAL_DEREF(value);
 	switch (Z_TYPE_P(container)) {
 	case IS_OBJECT:
-		zend_update_property(Z_OBJCE_P(container), container,
-				member->val, member->len, value);
+		write_object_property(container, key, value);
 		break;
 
 	case IS_ARRAY:
 		Z_TRY_ADDREF_P(value);
-		if (member) {
-			value = zend_symtable_update(Z_ARRVAL_P(container), member, value);
+		if (key) {
+			zval *slot = find_key(Z_ARRVAL_P(container), key);
+
+			if (slot && Z_ISREF_P(slot)) {
+				zval garbage;
+
+				/* assign through the reference, do not break it up */
+				slot = Z_REFVAL_P(slot);
+				ZVAL_COPY_VALUE(&garbage, slot);
+				ZVAL_COPY_VALUE(slot, value);
+				zval_ptr_dtor(&garbage);
+				value = slot;
+			} else if (Z_TYPE_P(key) == IS_LONG) {
+				value = zend_hash_index_update(Z_ARRVAL_P(container), Z_LVAL_P(key), value);
+			} else {
+				value = zend_hash_update(Z_ARRVAL_P(container), Z_STR_P(key), value);
+			}
 		} else {
 			value = zend_hash_next_index_insert(Z_ARRVAL_P(container), value);
 		}
@@ -439,242 +1153,2415 @@ static inline zval *set_container_value(zval *container, zend_string *member, zv
 	return value;
 }
 
-
-static zval *get_proxied_value(zval *object, zval *return_value)
+static inline void unset_container_value(zval *container, zval *key)
 {
-	php_property_proxy_object_t *obj = get_propro(object);
+	ZVAL_DEREF(container);
+	switch (Z_TYPE_P(container)) {
+	case IS_OBJECT:
+		if (Z_OBJ_HT_P(container)->unset_property) {
+			zend_class_entry *scope = swap_scope(Z_OBJCE_P(container));
+			zend_string *name = get_key_name(key);
+			zval zmember;
+
+			ZVAL_STR(&zmember, name);
+			Z_OBJ_HT_P(container)->unset_property(container, &zmember,
+					get_cache_slot(Z_OBJCE_P(container), name));
+			zend_string_release(name);
+			swap_scope(scope);
+		}
+		break;
 
-	debug_propro(1, "get", obj, NULL, NULL, NULL);
+	case IS_ARRAY:
+		if (Z_TYPE_P(key) == IS_LONG) {
+			zend_hash_index_del(Z_ARRVAL_P(container), Z_LVAL_P(key));
+		} else {
+			zend_hash_del(Z_ARRVAL_P(container), Z_STR_P(key));
+		}
+		break;
+	}
+}
 
-	if (obj->proxy) {
-		zval tmp, *container;
+/*
+ * Resolve the first \a levels members of the proxy's path in one pass into
+ * \a return_value, which is owned by the caller.
+ */
+static inline zval *get_path_value(php_property_proxy_t *proxy, uint32_t levels,
+		zval *return_value)
+{
+	zval *container = &proxy->container;
+	uint32_t i;
+
+	check_weak(proxy);
+	for (i = 0; i < levels; ++i) {
+		zval tmp;
 
 		ZVAL_UNDEF(&tmp);
-		container = get_container(object, &tmp);
+		if (!i && proxy->ops) {
+			proxy->ops->get(proxy->data, &proxy->path[0], &tmp);
+			if (Z_ISREF(tmp)) {
+				zval ref;
+
+				ZVAL_COPY_VALUE(&ref, &tmp);
+				ZVAL_COPY(&tmp, Z_REFVAL(ref));
+				zval_ptr_dtor(&ref);
+			}
+		} else {
+			get_container_value(container, &proxy->path[i], &tmp);
+		}
+		zval_ptr_dtor(return_value);
+		ZVAL_COPY_VALUE(return_value, &tmp);
 
-		return_value = get_container_value(container, obj->proxy->member, return_value);
+		if (Z_ISUNDEF_P(return_value)) {
+			break;
+		}
+		container = return_value;
 	}
 
-	debug_propro(-1, "get", obj, NULL, NULL, return_value);
-
 	return return_value;
 }
 
-static void set_proxied_value(zval *object, zval *value)
+/*
+ * Get the generation counter of the values resolved from \a root; roots
+ * sharing a counter merely invalidate each other's cached values.
+ */
+static inline uint32_t get_generation_slot(zval *root)
 {
-	php_property_proxy_object_t *obj = get_propro(object);
+	zend_uintptr_t h = 0;
 
-	debug_propro(1, "set", obj, NULL, NULL, value);
+	if (Z_REFCOUNTED_P(root)) {
+		h = (zend_uintptr_t) Z_COUNTED_P(root);
+	}
+	return (h >> 3) & (PROPRO_GENERATIONS - 1);
+}
 
-	if (obj->proxy) {
-		zval tmp, *container;
-		zend_bool separated;
+static inline zend_ulong *get_generation(zval *root)
+{
+	return &PROPRO_G(generations)[get_generation_slot(root)];
+}
 
-		Z_TRY_ADDREF_P(value);
+/*
+ * Bump \a generation and drop the values cached at it, so that writers do
+ * not have to separate the values they share with cached ones. Only the
+ * caching proxies of roots sharing the generation are visited, and only if
+ * any of them holds a cached value.
+ */
+static void invalidate(zend_ulong *generation)
+{
+	uint32_t slot = generation - PROPRO_G(generations), idx;
+	HashTable *ht = PROPRO_G(caching)[slot];
 
-		ZVAL_UNDEF(&tmp);
-		container = get_container(object, &tmp);
-		separated = separate_container(object, container);
-		set_container_value(container, obj->proxy->member, value);
-		set_container(object, container);
-		cleanup_container(object, container, separated);
+	++*generation;
 
-		Z_TRY_DELREF_P(value);
+	/* releasing a value might run code, which changes the registry */
+	for (idx = 0; ht && PROPRO_G(cached)[slot] && idx < ht->nNumUsed; ++idx) {
+		php_property_proxy_t *proxy;
+		zval garbage;
 
-		debug_propro(0, "set", obj, NULL, NULL, value);
+		if (Z_ISUNDEF(ht->arData[idx].val)) {
+			continue;
+		}
+		proxy = Z_PTR(ht->arData[idx].val);
+		if (Z_ISUNDEF(proxy->cached)) {
+			continue;
+		}
+		--PROPRO_G(cached)[slot];
+		ZVAL_COPY_VALUE(&garbage, &proxy->cached);
+		ZVAL_UNDEF(&proxy->cached);
+		zval_ptr_dtor(&garbage);
 	}
-
-	debug_propro(-1, "set", obj, NULL, NULL, value);
 }
 
-static zval *read_dimension(zval *object, zval *offset, int type, zval *return_value)
+/*
+ * Resolve the proxied value like get_path_value(), unless it has been
+ * cached at the current generation of the root container.
+ */
+static inline zval *get_cached_value(php_property_proxy_t *proxy,
+		zval *return_value)
 {
-	zval *value, tmp;
-	zend_string *member = offset ? zval_get_string(offset) : NULL;
+	uint32_t slot = get_generation_slot(&proxy->container);
+	zend_ulong generation = PROPRO_G(generations)[slot];
 
-	debug_propro(1, type == BP_VAR_R ? "dim_r" : "dim_R",
-			get_propro(object), NULL, offset, NULL);
-
-	ZVAL_UNDEF(&tmp);
-	value = get_proxied_value(object, &tmp);
+	if (Z_ISUNDEF(proxy->cached) || proxy->generation != generation) {
+		zval tmp;
 
-	if (type == BP_VAR_R || type == BP_VAR_IS) {
-		ZEND_ASSERT(member);
+		ZVAL_UNDEF(&tmp);
+		get_path_value(proxy, proxy->depth, &tmp);
+		/* resolving might have run code, which invalidated the value */
+		if (Z_ISUNDEF(proxy->cached)) {
+			PROPRO_G(cached)[slot] += !Z_ISUNDEF(tmp);
+		} else {
+			PROPRO_G(cached)[slot] -= Z_ISUNDEF(tmp);
+			zval_ptr_dtor(&proxy->cached);
+		}
+		ZVAL_COPY_VALUE(&proxy->cached, &tmp);
+		proxy->generation = generation;
+	}
+	ZVAL_COPY(return_value, &proxy->cached);
 
-		if (!Z_ISUNDEF_P(value)) {
-			zval tmp;
+	return return_value;
+}
 
-			ZVAL_UNDEF(&tmp);
-			RETVAL_ZVAL(get_container_value(value, member, &tmp), 1, 0);
-		}
+/*
+ * Append the encoding of \a key to \a buf; the encoding of a path is the
+ * concatenation of the encodings of its keys, so a path is the prefix of
+ * the paths below it.
+ */
+static inline void encode_key(smart_str *buf, zval *key)
+{
+	if (Z_TYPE_P(key) == IS_LONG) {
+		smart_str_appendc(buf, 'i');
+		smart_str_append_long(buf, Z_LVAL_P(key));
 	} else {
-		php_property_proxy_t *proxy;
-		php_property_proxy_object_t *proxy_obj;
+		smart_str_appendc(buf, 's');
+		smart_str_append_long(buf, Z_STRLEN_P(key));
+		smart_str_appendc(buf, ':');
+		smart_str_append(buf, Z_STR_P(key));
+	}
+	smart_str_appendc(buf, ';');
+}
 
-		if (Z_ISUNDEF_P(value)) {
-			ZVAL_NULL(value);
+static inline php_propro_journal_t *get_journal(zval *root)
+{
+	if (!PROPRO_G(journals) || !Z_REFCOUNTED_P(root)) {
+		return NULL;
+	}
+	return zend_hash_index_find_ptr(PROPRO_G(journals),
+			(zend_ulong) (zend_uintptr_t) Z_COUNTED_P(root));
+}
+
+/*
+ * Record the change of \a key of the value found after descending \a levels
+ * of the proxy's path in the journal of its root container; a NULL \a key
+ * records the change of the value itself. Changes below an already
+ * recorded path are implied by it, and imply nothing themselves.
+ */
+static void journal_change(php_property_proxy_t *proxy, uint32_t levels,
+		zval *key)
+{
+	php_propro_journal_t *journal;
+	smart_str buf = {0};
+	uint32_t i, n = levels + !!key;
+	zend_string *enc;
+	zval path;
+
+	/* writes to the buffer of a deferring proxy are recorded on commit */
+	if (proxy->deferred && levels == proxy->depth) {
+		return;
+	}
+	check_weak(proxy);
+	if (!(journal = get_journal(&proxy->container))) {
+		return;
+	}
+
+	for (i = 0; ; ++i) {
+		if (buf.s) {
+			smart_str_0(&buf);
+			enc = buf.s;
+		} else {
+			enc = ZSTR_EMPTY_ALLOC();
+		}
+		if (zend_hash_exists(&journal->changes, enc)) {
+			smart_str_free(&buf);
+			return;
 		}
+		if (i == n) {
+			break;
+		}
+		encode_key(&buf, i < levels ? &proxy->path[i] : key);
+		/* the lookup above cached the hash of the shorter prefix */
+		zend_string_forget_hash_val(buf.s);
+	}
 
-		if (!member) {
-			if (Z_TYPE_P(value) == IS_ARRAY) {
-				member = zend_long_to_str(zend_hash_next_free_element(
-					Z_ARRVAL_P(value)));
-			} else if (Z_TYPE_P(value) != IS_OBJECT){
-				member = zend_long_to_str(0);
+	if (journal->depth > n) {
+		zend_string *other;
+
+		ZEND_HASH_FOREACH_STR_KEY(&journal->changes, other)
+		{
+			if (ZSTR_LEN(other) > ZSTR_LEN(enc)
+			&&	!memcmp(ZSTR_VAL(other), ZSTR_VAL(enc), ZSTR_LEN(enc))) {
+				zend_hash_del(&journal->changes, other);
 			}
 		}
+		ZEND_HASH_FOREACH_END();
+	} else {
+		journal->depth = n;
+	}
 
-		proxy = php_property_proxy_init(NULL, member);
-		proxy_obj = php_property_proxy_object_new_ex(NULL, proxy);
-		ZVAL_COPY(&proxy_obj->parent, object);
-		RETVAL_OBJ(&proxy_obj->zo);
+	array_init_size(&path, n);
+	for (i = 0; i < n; ++i) {
+		zval *k = i < levels ? &proxy->path[i] : key;
 
-		debug_propro(0, "dim_R pp", get_propro(object), NULL, offset, return_value);
+		Z_TRY_ADDREF_P(k);
+		add_next_index_zval(&path, k);
+	}
+	zend_hash_add_new(&journal->changes, enc, &path);
+	smart_str_free(&buf);
+}
+
+static void free_journal(zval *zv)
+{
+	php_propro_journal_t *journal = Z_PTR_P(zv);
+
+	zend_hash_destroy(&journal->changes);
+	zval_ptr_dtor(&journal->container);
+	efree(journal);
+}
+
+#define PROPRO_PATH_STACK 8
+
+typedef struct php_property_proxy_writeback {
+	/** The object, which does not provide a slot for key */
+	zval object;
+	/** The key of the property, NULL if value references the property */
+	zval *key;
+	/** The separated value of the property to write back */
+	zval value;
+} php_property_proxy_writeback_t;
+
+typedef struct php_property_proxy_write {
+	php_property_proxy_t *proxy;
+	/** The generation of the root container, bumped by write_end() */
+	zend_ulong *generation;
+	php_property_proxy_writeback_t *pending;
+	uint32_t count;
+	php_property_proxy_writeback_t stack[PROPRO_PATH_STACK];
+} php_property_proxy_write_t;
+
+/*
+ * Find or add the slot of \a key in \a container, which is writable.
+ * Objects, which do not provide slots for their properties, get their
+ * separated property values written back by write_end(), unless they
+ * returned a reference to the property, which is written to in place.
+ */
+static zval *write_slot(php_property_proxy_write_t *w, zval *container, zval *key)
+{
+	php_property_proxy_writeback_t *wb;
+	zval rv, *slot, *found;
+
+	/* native storage is accessed through the proxy's ops */
+	if (!container) {
+		php_property_proxy_t *proxy = w->proxy;
+
+		wb = &w->pending[w->count++];
+		ZVAL_UNDEF(&wb->object);
+		ZVAL_UNDEF(&wb->value);
+		proxy->ops->get(proxy->data, key, &wb->value);
+		wb->key = Z_ISREF(wb->value) ? NULL : key;
+
+		return &wb->value;
 	}
 
-	if (member) {
-		zend_string_release(member);
+	if (Z_TYPE_P(container) == IS_ARRAY) {
+		return get_array_slot(container, key);
+	}
+	if ((slot = get_object_slot(container, key))) {
+		return slot;
 	}
 
-	debug_propro(-1, type == BP_VAR_R ? "dim_r" : "dim_R",
-			get_propro(object), NULL, offset, return_value);
+	wb = &w->pending[w->count++];
+	ZVAL_UNDEF(&rv);
+	found = read_object_property(container, key, &rv);
+	if (Z_ISREF_P(found)) {
+		/* like the result of __get() returning by reference */
+		ZVAL_COPY(&wb->value, found);
+		ZVAL_UNDEF(&wb->object);
+		wb->key = NULL;
+	} else {
+		ZVAL_COPY(&wb->value, found);
+		ZVAL_COPY(&wb->object, container);
+		wb->key = key;
+	}
+	zval_ptr_dtor(&rv);
 
-	return return_value;
+	return &wb->value;
 }
 
-static int has_dimension(zval *object, zval *offset, int check_empty)
+/*
+ * Descend the first \a levels members of the proxy's path once, making the
+ * slot found at each level writable, and return the container of the next
+ * member, which the caller may pass on to write_slot().
+ */
+static inline void write_init(php_property_proxy_write_t *w,
+		php_property_proxy_t *proxy, zval *root, uint32_t levels)
 {
-	zval *value, tmp;
-	int exists = 0;
+	w->proxy = proxy;
+	w->generation = get_generation(root);
+	invalidate(w->generation);
+	w->count = 0;
+	w->pending = w->stack;
+	if (levels >= PROPRO_PATH_STACK) {
+		w->pending = safe_emalloc(levels + 1, sizeof(*w->pending), 0);
+	}
+}
 
-	debug_propro(1, "dim_e", get_propro(object), NULL, offset, NULL);
+static zval *write_begin(php_property_proxy_write_t *w, php_property_proxy_t *proxy,
+		uint32_t levels)
+{
+	zval *container;
+	uint32_t i;
 
-	ZVAL_UNDEF(&tmp);
-	value = get_proxied_value(object, &tmp);
+	/* the writes of a deferring proxy go to its buffer */
+	if (proxy->deferred && levels == proxy->depth) {
+		write_init(w, proxy, &proxy->deferred->buffer, 0);
+		return separate_slot(&proxy->deferred->buffer);
+	}
 
-	if (!Z_ISUNDEF_P(value)) {
-		zend_string *zs = zval_get_string(offset);
+	check_weak(proxy);
+	write_init(w, proxy, &proxy->container, levels);
+	container = proxy->ops ? NULL : separate_slot(&proxy->container);
+	for (i = 0; i < levels; ++i) {
+		container = separate_slot(write_slot(w, container, &proxy->path[i]));
+	}
 
-		ZVAL_DEREF(value);
-		if (Z_TYPE_P(value) == IS_ARRAY) {
-			zval *zentry = zend_symtable_find(Z_ARRVAL_P(value), zs);
+	return container;
+}
 
-			if (zentry) {
-				if (check_empty) {
-					exists = !Z_ISNULL_P(zentry);
-				} else {
-					exists = 1;
-				}
+/*
+ * Write back the separated property values of objects without slots.
+ */
+static void write_end(php_property_proxy_write_t *w)
+{
+	while (w->count--) {
+		php_property_proxy_writeback_t *wb = &w->pending[w->count];
+		zval *value = &wb->value;
+
+		/* references have been written to in place */
+		if (wb->key) {
+			ZVAL_DEREF(value);
+			++PROPRO_STAT(writebacks);
+			if (Z_ISUNDEF(wb->object)) {
+				w->proxy->ops->set(w->proxy->data, wb->key, value);
+			} else {
+				write_object_property(&wb->object, wb->key, value);
 			}
 		}
-
-		zend_string_release(zs);
+		zval_ptr_dtor(&wb->value);
+		zval_ptr_dtor(&wb->object);
 	}
 
-	debug_propro(-1, "dim_e", get_propro(object), NULL, offset, NULL);
+	if (w->pending != w->stack) {
+		efree(w->pending);
+	}
 
-	return exists;
+	invalidate(w->generation);
 }
 
-static void write_dimension(zval *object, zval *offset, zval *input_value)
+/*
+ * Write \a value to \a key of the value found after descending \a levels
+ * of the proxy's path; a NULL \a key appends.
+ */
+static void write_path_value(php_property_proxy_t *proxy, uint32_t levels,
+		zval *key, zval *value)
 {
-	zval *array, tmp;
-	zend_string *zs = NULL;
-	zend_bool separated;
-
-	debug_propro(1, "dim_w", get_propro(object), NULL, offset, input_value);
+	php_property_proxy_write_t w;
+	zval *container;
 
-	if (offset) {
-		zs = zval_get_string(offset);
+	journal_change(proxy, levels, key);
+	if (!levels && proxy->ops) {
+		ZVAL_DEREF(value);
+		proxy->ops->set(proxy->data, key, value);
+		invalidate(get_generation(&proxy->container));
+		return;
 	}
 
-	ZVAL_UNDEF(&tmp);
-	array = get_proxied_value(object, &tmp);
-	separated = separate_container(object, array);
-	set_container_value(array, zs, input_value);
-	set_proxied_value(object, array);
-	cleanup_container(object, array, separated);
+	container = write_begin(&w, proxy, levels);
+	set_container_value(container, key, value);
+	write_end(&w);
+}
 
-	if (zs) {
-		zend_string_release(zs);
+void php_property_proxy_write_many(php_property_proxy_t *proxy, HashTable *values,
+		HashTable *keys)
+{
+	php_property_proxy_write_t w;
+	zval *container, *entry, key;
+	zend_string *name;
+	zend_ulong index;
+
+	debug_propro(1, "many", NULL, proxy, NULL, NULL);
+
+	container = write_begin(&w, proxy, proxy->depth);
+
+	if (values) {
+		ZEND_HASH_FOREACH_KEY_VAL_IND(values, index, name, entry)
+		{
+			if (name) {
+				ZVAL_STR(&key, name);
+			} else {
+				ZVAL_LONG(&key, index);
+			}
+			journal_change(proxy, proxy->depth, &key);
+			set_container_value(container, &key, entry);
+		}
+		ZEND_HASH_FOREACH_END();
+	}
+	if (keys) {
+		ZEND_HASH_FOREACH_VAL_IND(keys, entry)
+		{
+			init_key(&key, entry);
+			journal_change(proxy, proxy->depth, &key);
+			unset_container_value(container, &key);
+			zval_ptr_dtor(&key);
+		}
+		ZEND_HASH_FOREACH_END();
 	}
 
-	debug_propro(-1, "dim_w", get_propro(object), NULL, offset, input_value);
+	write_end(&w);
+
+	debug_propro(-1, "many", NULL, proxy, NULL, NULL);
 }
 
-static void unset_dimension(zval *object, zval *offset)
+void php_property_proxy_reserve(php_property_proxy_t *proxy, uint32_t n,
+		zend_bool packed)
 {
-	zval *array, *value, tmp;
-
-	debug_propro(1, "dim_u", get_propro(object), NULL, offset, NULL);
-
-	ZVAL_UNDEF(&tmp);
-	value = get_proxied_value(object, &tmp);
-	array = value;
-	ZVAL_DEREF(array);
+	php_property_proxy_write_t w;
+	zval *slot;
 
-	if (Z_TYPE_P(array) == IS_ARRAY) {
-		zend_string *o = zval_get_string(offset);
+	debug_propro(1, "reserve", NULL, proxy, NULL, NULL);
 
-		SEPARATE_ARRAY(array);
-		zend_symtable_del(Z_ARRVAL_P(array), o);
+	if (proxy->deferred) {
+		write_init(&w, proxy, &proxy->deferred->buffer, 0);
+		slot = &proxy->deferred->buffer;
+	} else {
+		zval *container = write_begin(&w, proxy, proxy->depth - 1);
 
-		set_proxied_value(object, value);
+		slot = write_slot(&w, container, &proxy->path[proxy->depth - 1]);
+		ZVAL_DEREF(slot);
+		/* vivifying the property changes it */
+		if (Z_TYPE_P(slot) != IS_ARRAY && Z_TYPE_P(slot) != IS_OBJECT) {
+			journal_change(proxy, proxy->depth - 1, &proxy->path[proxy->depth - 1]);
+		}
+	}
 
-		zend_string_release(o);
+	slot = separate_slot(slot);
+	if (Z_TYPE_P(slot) == IS_ARRAY) {
+		reserve_array(Z_ARRVAL_P(slot), n, packed);
 	}
+	write_end(&w);
 
-	debug_propro(-1, "dim_u", get_propro(object), NULL, offset, NULL);
+	debug_propro(-1, "reserve", NULL, proxy, NULL, slot);
 }
 
-ZEND_BEGIN_ARG_INFO_EX(ai_propro_construct, 0, 0, 2)
-	ZEND_ARG_INFO(0, object)
-	ZEND_ARG_INFO(0, member)
-	ZEND_ARG_OBJ_INFO(0, parent, php\\PropertyProxy, 1)
-ZEND_END_ARG_INFO();
-static PHP_METHOD(propro, __construct) {
-	zend_error_handling zeh;
-	zval *reference, *parent = NULL;
-	zend_string *member;
+/*
+ * Commit the buffers of all deferring proxies, which keep deferring. Commits
+ * might run user code, which defers or destroys proxies, so only the ones
+ * deferring before and still deferring are committed.
+ */
+static void commit_deferred(void)
+{
+	HashTable *snapshot;
+	zend_ulong key;
 
-	zend_replace_error_handling(EH_THROW, NULL, &zeh);
-	if (SUCCESS == zend_parse_parameters(ZEND_NUM_ARGS(), "o!S|O!",
-			&reference, &member, &parent,
-			php_property_proxy_class_entry)) {
-		php_property_proxy_object_t *obj;
+	if (!PROPRO_G(deferred)) {
+		return;
+	}
 
-		obj = get_propro(getThis());
+	snapshot = zend_array_dup(PROPRO_G(deferred));
+	ZEND_HASH_FOREACH_NUM_KEY(snapshot, key) {
+		zval *entry = zend_hash_index_find(PROPRO_G(deferred), key);
 
-		if (parent) {
-			ZVAL_COPY(&obj->parent, parent);
-			obj->proxy = php_property_proxy_init(NULL, member);
-		} else if (reference) {
-			zval *container = reference;
-			obj->proxy = php_property_proxy_init(container, member);
-		} else {
-			php_error(E_WARNING, "Either object or parent must be set");
+		if (entry) {
+			php_property_proxy_commit(Z_PTR_P(entry));
 		}
-	}
-	zend_restore_error_handling(&zeh);
+	} ZEND_HASH_FOREACH_END();
+	zend_array_destroy(snapshot);
 }
 
-static const zend_function_entry php_property_proxy_method_entry[] = {
-	PHP_ME(propro, __construct, ai_propro_construct, ZEND_ACC_PUBLIC)
-	{0}
-};
+/*
+ * Commit the deferred writes by a shutdown function, which runs before the
+ * destructors and while user code still may run.
+ */
+static void register_commit(void)
+{
+	static char name[] = "php\\propro_commit_all";
+	php_shutdown_function_entry entry;
+
+	entry.arg_count = 1;
+	entry.arguments = safe_emalloc(1, sizeof(zval), 0);
+	ZVAL_STRINGL(&entry.arguments[0], name, sizeof(name) - 1);
+	register_user_shutdown_function(name, sizeof(name) - 1, &entry);
+	PROPRO_G(committing) = 1;
+}
 
-static PHP_MINIT_FUNCTION(propro)
+void php_property_proxy_defer(php_property_proxy_t *proxy)
 {
-	zend_class_entry ce = {0};
+	php_property_proxy_deferred_t *deferred;
+	zval tmp;
 
-	INIT_NS_CLASS_ENTRY(ce, "php", "PropertyProxy",
-			php_property_proxy_method_entry);
-	php_property_proxy_class_entry = zend_register_internal_class(&ce);
-	php_property_proxy_class_entry->create_object =	php_property_proxy_object_new;
-	php_property_proxy_class_entry->ce_flags |= ZEND_ACC_FINAL;
+	if (proxy->deferred) {
+		return;
+	}
+	/* interned child proxies do not know about the buffer */
+	if (proxy->children) {
+		free_children(proxy);
+	}
 
-	memcpy(&php_property_proxy_object_handlers, zend_get_std_object_handlers(),
-			sizeof(zend_object_handlers));
+	ZVAL_UNDEF(&tmp);
+	get_path_value(proxy, proxy->depth, &tmp);
+	if (Z_ISUNDEF(tmp)) {
+		ZVAL_NULL(&tmp);
+	}
+
+	deferred = emalloc(sizeof(*deferred));
+	ZVAL_COPY(&deferred->committed, &tmp);
+	ZVAL_NEW_REF(&deferred->buffer, &tmp);
+	proxy->deferred = deferred;
+
+	if (!PROPRO_G(deferred)) {
+		ALLOC_HASHTABLE(PROPRO_G(deferred));
+		zend_hash_init(PROPRO_G(deferred), 8, NULL, NULL, 0);
+	}
+	ZVAL_PTR(&tmp, proxy);
+	zend_hash_index_update(PROPRO_G(deferred), (zend_ulong) (zend_uintptr_t) proxy, &tmp);
+	if (!PROPRO_G(committing)) {
+		register_commit();
+	}
+
+	debug_propro(0, "defer", NULL, proxy, NULL, Z_REFVAL(deferred->buffer));
+}
+
+void php_property_proxy_commit(php_property_proxy_t *proxy)
+{
+	php_property_proxy_deferred_t *deferred = proxy->deferred;
+	zval *value;
+
+	if (!deferred) {
+		return;
+	}
+
+	value = Z_REFVAL(deferred->buffer);
+	if (zend_is_identical(value, &deferred->committed)) {
+		return;
+	}
+
+	debug_propro(1, "commit", NULL, proxy, NULL, value);
+
+	/* protect the value while writing it, the reference is kept afterwards */
+	Z_TRY_ADDREF_P(value);
+	zval_ptr_dtor(&deferred->committed);
+	ZVAL_COPY_VALUE(&deferred->committed, value);
+
+	proxy->deferred = NULL;
+	write_path_value(proxy, proxy->depth - 1, &proxy->path[proxy->depth - 1], value);
+	proxy->deferred = deferred;
+
+	debug_propro(-1, "commit", NULL, proxy, NULL, value);
+}
+
+/*
+ * Leave deferred write-back mode; child proxies keep their reference to the
+ * buffer, though.
+ */
+static void end_deferred(php_property_proxy_t *proxy, zend_bool commit)
+{
+	php_property_proxy_deferred_t *deferred = proxy->deferred;
+
+	if (commit) {
+		php_property_proxy_commit(proxy);
+	}
+	zend_hash_index_del(PROPRO_G(deferred), (zend_ulong) (zend_uintptr_t) proxy);
+	if (proxy->children) {
+		free_children(proxy);
+	}
+
+	proxy->deferred = NULL;
+	zval_ptr_dtor(&deferred->buffer);
+	zval_ptr_dtor(&deferred->committed);
+	efree(deferred);
+}
+
+void php_property_proxy_cache(php_property_proxy_t *proxy, zend_bool enable)
+{
+	uint32_t slot;
+	zval tmp;
+
+	if (!enable) {
+		if (proxy->caching) {
+			end_caching(proxy);
+		}
+		return;
+	}
+	if (proxy->caching) {
+		return;
+	}
+
+	check_weak(proxy);
+	slot = get_generation_slot(&proxy->container);
+	if (!PROPRO_G(caching)[slot]) {
+		ALLOC_HASHTABLE(PROPRO_G(caching)[slot]);
+		zend_hash_init(PROPRO_G(caching)[slot], 8, NULL, NULL, 0);
+	}
+	ZVAL_PTR(&tmp, proxy);
+	zend_hash_index_update(PROPRO_G(caching)[slot],
+			(zend_ulong) (zend_uintptr_t) proxy, &tmp);
+	proxy->caching = 1;
+}
+
+static void end_caching(php_property_proxy_t *proxy)
+{
+	uint32_t slot = get_generation_slot(&proxy->container);
+
+	/* the registry is gone after RSHUTDOWN */
+	if (PROPRO_G(caching)[slot]) {
+		zend_hash_index_del(PROPRO_G(caching)[slot],
+				(zend_ulong) (zend_uintptr_t) proxy);
+		PROPRO_G(cached)[slot] -= !Z_ISUNDEF(proxy->cached);
+	}
+	proxy->caching = 0;
+	zval_ptr_dtor(&proxy->cached);
+	ZVAL_UNDEF(&proxy->cached);
+}
+
+void php_property_proxy_invalidate(zval *container)
+{
+	invalidate(get_generation(container));
+}
+
+void php_property_proxy_journal(zval *container, zend_bool enable)
+{
+	php_propro_journal_t *journal;
+	zend_ulong h;
+
+	if (!Z_REFCOUNTED_P(container)) {
+		return;
+	}
+	h = (zend_ulong) (zend_uintptr_t) Z_COUNTED_P(container);
+
+	if (!enable) {
+		if (PROPRO_G(journals)) {
+			zend_hash_index_del(PROPRO_G(journals), h);
+		}
+		return;
+	}
+	if (get_journal(container)) {
+		return;
+	}
+
+	if (!PROPRO_G(journals)) {
+		ALLOC_HASHTABLE(PROPRO_G(journals));
+		zend_hash_init(PROPRO_G(journals), 8, NULL, free_journal, 0);
+	}
+	journal = emalloc(sizeof(*journal));
+	ZVAL_COPY(&journal->container, container);
+	zend_hash_init(&journal->changes, 8, NULL, ZVAL_PTR_DTOR, 0);
+	journal->depth = 0;
+	zend_hash_index_add_new_ptr(PROPRO_G(journals), h, journal);
+}
+
+HashTable *php_property_proxy_changes(zval *container)
+{
+	php_propro_journal_t *journal = get_journal(container);
+
+	return journal ? &journal->changes : NULL;
+}
+
+void php_property_proxy_clear_changes(zval *container)
+{
+	php_propro_journal_t *journal = get_journal(container);
+
+	if (journal) {
+		zend_hash_clean(&journal->changes);
+		journal->depth = 0;
+	}
+}
+
+void php_property_proxy_untrack(php_property_proxy_t *proxy, zend_bool enable)
+{
+	/* interned child proxy objects have been instantiated in the other mode */
+	if (proxy->untracked != enable && proxy->children) {
+		free_children(proxy);
+	}
+	proxy->untracked = enable;
+}
+
+ZEND_RESULT_CODE php_property_proxy_weaken(php_property_proxy_t *proxy)
+{
+#if PHP_VERSION_ID >= 70400
+	zval weakref;
+
+	check_weak(proxy);
+	if (proxy->weakref) {
+		return SUCCESS;
+	}
+	/* native storage has to live as long as the proxy */
+	if (proxy->ops || Z_TYPE(proxy->container) != IS_OBJECT) {
+		return FAILURE;
+	}
+
+	ZVAL_UNDEF(&weakref);
+	zend_call_method(NULL, zend_ce_weakref, NULL, "create", sizeof("create")-1,
+			&weakref, 1, &proxy->container, NULL);
+	if (Z_TYPE(weakref) != IS_OBJECT) {
+		zval_ptr_dtor(&weakref);
+		return FAILURE;
+	}
+
+	/* interned child proxy objects hold on to the container */
+	if (proxy->children) {
+		free_children(proxy);
+	}
+	proxy->weakref = Z_OBJ(weakref);
+	/* borrow the container, which might be freed right away */
+	zval_ptr_dtor(&proxy->container);
+
+	debug_propro(0, "weak", NULL, proxy, NULL, NULL);
+
+	return SUCCESS;
+#else
+	return FAILURE;
+#endif
+}
+
+php_property_proxy_t *php_property_proxy_compile(const char *path, size_t len)
+{
+	php_property_proxy_t *proxy;
+	zval *keys = NULL, str;
+	uint32_t n = 0, size = 0;
+	size_t pos = 0;
+
+	while (pos < len) {
+		const char *seg = &path[pos];
+		size_t seg_len;
+
+		if (*seg == '[') {
+			const char *end = memchr(seg + 1, ']', len - pos - 1);
+
+			if (!end) {
+				goto fail;
+			}
+			++seg;
+			seg_len = end - seg;
+			pos = end - path + 1;
+			/* a key in brackets is followed by another key */
+			if (pos < len && path[pos] != '.' && path[pos] != '[') {
+				goto fail;
+			}
+		} else {
+			while (pos < len && path[pos] != '.' && path[pos] != '[') {
+				++pos;
+			}
+			seg_len = &path[pos] - seg;
+		}
+		if (!seg_len) {
+			goto fail;
+		}
+
+		if (n == size) {
+			size = size ? size << 1 : PHP_PROPRO_PATH_INLINE;
+			keys = safe_erealloc(keys, size, sizeof(*keys), 0);
+		}
+		ZVAL_STRINGL(&str, seg, seg_len);
+		init_key(&keys[n++], &str);
+		zval_ptr_dtor(&str);
+
+		/* a dot is followed by a name */
+		if (pos < len && path[pos] == '.') {
+			if (++pos == len || path[pos] == '.' || path[pos] == '[') {
+				goto fail;
+			}
+		}
+	}
+	if (!n) {
+		return NULL;
+	}
+
+	proxy = pool_get(&PROPRO_G(proxies), sizeof(*proxy));
+	init_proxy(proxy, NULL, n);
+	memcpy(proxy->path, keys, n * sizeof(*keys));
+	efree(keys);
+	if (Z_TYPE(proxy->path[n - 1]) == IS_STRING) {
+		proxy->member = Z_STR(proxy->path[n - 1]);
+	}
+
+	debug_propro(0, "compile", NULL, proxy, NULL, NULL);
+
+	return proxy;
+
+fail:
+	while (n--) {
+		zval_ptr_dtor(&keys[n]);
+	}
+	if (keys) {
+		efree(keys);
+	}
+	return NULL;
+}
+
+/*
+ * Initialize a temporary proxy of \a root, which borrows the keys of the
+ * compiled \a path.
+ */
+static inline void init_path_proxy(php_property_proxy_t *proxy,
+		php_property_proxy_t *path, zval *root)
+{
+	*proxy = *path;
+	ZVAL_COPY_VALUE(&proxy->container, root);
+	ZVAL_UNDEF(&proxy->cached);
+	proxy->deferred = NULL;
+	proxy->children = NULL;
+	proxy->weakref = NULL;
+	proxy->caching = 0;
+}
+
+zval *php_property_proxy_path_get(php_property_proxy_t *path, zval *root,
+		zval *return_value)
+{
+	php_property_proxy_t proxy;
+
+	init_path_proxy(&proxy, path, root);
+	ZVAL_UNDEF(return_value);
+
+	return get_path_value(&proxy, proxy.depth, return_value);
+}
+
+void php_property_proxy_path_set(php_property_proxy_t *path, zval *root,
+		zval *value)
+{
+	php_property_proxy_t proxy;
+
+	if (Z_TYPE_P(root) != IS_REFERENCE && Z_TYPE_P(root) != IS_OBJECT) {
+		return;
+	}
+
+	init_path_proxy(&proxy, path, root);
+
+	/* protect the value while writing it, it might be part of root */
+	ZVAL_DEREF(value);
+	Z_TRY_ADDREF_P(value);
+	write_path_value(&proxy, proxy.depth - 1, &proxy.path[proxy.depth - 1], value);
+	Z_TRY_DELREF_P(value);
+}
+
+int php_property_proxy_path_has(php_property_proxy_t *path, zval *root)
+{
+	zval tmp;
+	int exists;
+
+	php_property_proxy_path_get(path, root, &tmp);
+	exists = Z_TYPE(tmp) > IS_NULL;
+	zval_ptr_dtor(&tmp);
+
+	return exists;
+}
+
+void php_property_proxy_path_unset(php_property_proxy_t *path, zval *root)
+{
+	php_property_proxy_t proxy;
+	php_property_proxy_write_t w;
+	zval tmp, *container;
+	int type;
+
+	if (Z_TYPE_P(root) != IS_REFERENCE && Z_TYPE_P(root) != IS_OBJECT) {
+		return;
+	}
+
+	init_path_proxy(&proxy, path, root);
+
+	/* do not create the containers of a missing property */
+	if (proxy.depth > 1) {
+		ZVAL_UNDEF(&tmp);
+		get_path_value(&proxy, proxy.depth - 1, &tmp);
+		type = Z_TYPE(tmp);
+		/* do not force write_begin() to separate the value */
+		zval_ptr_dtor(&tmp);
+	} else {
+		type = Z_TYPE_P(Z_ISREF_P(root) ? Z_REFVAL_P(root) : root);
+	}
+
+	if (type == IS_ARRAY || type == IS_OBJECT) {
+		journal_change(&proxy, proxy.depth - 1, &proxy.path[proxy.depth - 1]);
+		container = write_begin(&w, &proxy, proxy.depth - 1);
+		unset_container_value(container, &proxy.path[proxy.depth - 1]);
+		write_end(&w);
+	}
+}
+
+/*
+ * Compile a path from a list of keys.
+ */
+static php_property_proxy_t *compile_keys(HashTable *keys)
+{
+	php_property_proxy_t *proxy;
+	uint32_t n = zend_hash_num_elements(keys), i = 0;
+	zval *entry;
+
+	if (!n) {
+		return NULL;
+	}
+
+	proxy = pool_get(&PROPRO_G(proxies), sizeof(*proxy));
+	init_proxy(proxy, NULL, n);
+	ZEND_HASH_FOREACH_VAL(keys, entry)
+	{
+		init_key(&proxy->path[i++], entry);
+	}
+	ZEND_HASH_FOREACH_END();
+	if (Z_TYPE(proxy->path[n - 1]) == IS_STRING) {
+		proxy->member = Z_STR(proxy->path[n - 1]);
+	}
+
+	return proxy;
+}
+
+static inline void gather_row(php_property_proxy_t *proxy, zval *row,
+		zval *return_value)
+{
+	zval value;
+
+	ZVAL_COPY_VALUE(&proxy->container, row);
+	ZVAL_UNDEF(&value);
+	get_path_value(proxy, proxy->depth, &value);
+	if (Z_ISUNDEF(value)) {
+		ZVAL_NULL(&value);
+	}
+	zend_hash_next_index_insert_new(Z_ARRVAL_P(return_value), &value);
+}
+
+void php_property_proxy_gather(php_property_proxy_t *path, zval *containers,
+		zval *return_value)
+{
+	php_property_proxy_t proxy;
+	zval rows, *row;
+
+	init_path_proxy(&proxy, path, &EG(uninitialized_zval));
+
+	/* keep the rows alive, whatever the property handlers do */
+	ZVAL_DEREF(containers);
+	ZVAL_COPY(&rows, containers);
+
+	if (Z_TYPE(rows) == IS_ARRAY) {
+		array_init_size(return_value, zend_hash_num_elements(Z_ARRVAL(rows)));
+		zend_hash_real_init(Z_ARRVAL_P(return_value), 1);
+		ZEND_HASH_FOREACH_VAL_IND(Z_ARRVAL(rows), row)
+		{
+			gather_row(&proxy, row, return_value);
+		}
+		ZEND_HASH_FOREACH_END();
+	} else if (Z_TYPE(rows) == IS_OBJECT && Z_OBJCE(rows)->get_iterator) {
+		zend_object_iterator *it;
+
+		array_init(return_value);
+		it = Z_OBJCE(rows)->get_iterator(Z_OBJCE(rows), &rows, 0);
+		if (it && !EG(exception)) {
+			if (it->funcs->rewind) {
+				it->funcs->rewind(it);
+			}
+			while (!EG(exception) && SUCCESS == it->funcs->valid(it)) {
+				row = it->funcs->get_current_data(it);
+				if (EG(exception)) {
+					break;
+				}
+				gather_row(&proxy, row, return_value);
+				it->funcs->move_forward(it);
+			}
+		}
+		if (it) {
+			zend_iterator_dtor(it);
+		}
+	} else {
+		array_init(return_value);
+	}
+
+	zval_ptr_dtor(&rows);
+}
+
+static inline void scatter_row(php_property_proxy_t *proxy, zval *row,
+		zval *value)
+{
+	zend_bool unref = 0;
+
+	/* arrays are written in place through a temporary reference */
+	if (Z_TYPE_P(row) != IS_OBJECT && !Z_ISREF_P(row)) {
+		ZVAL_MAKE_REF(row);
+		unref = 1;
+	}
+	ZVAL_COPY_VALUE(&proxy->container, row);
+
+	/* protect the value while writing it, it might be part of a row */
+	ZVAL_DEREF(value);
+	Z_TRY_ADDREF_P(value);
+	write_path_value(proxy, proxy->depth - 1, &proxy->path[proxy->depth - 1], value);
+	Z_TRY_DELREF_P(value);
+
+	if (unref && Z_REFCOUNT_P(row) == 1) {
+		ZVAL_UNREF(row);
+	}
+}
+
+void php_property_proxy_scatter(php_property_proxy_t *path, HashTable *containers,
+		HashTable *values)
+{
+	php_property_proxy_t proxy;
+	HashPosition pos;
+	zval *row, *value;
+
+	init_path_proxy(&proxy, path, &EG(uninitialized_zval));
+
+	zend_hash_internal_pointer_reset_ex(values, &pos);
+	ZEND_HASH_FOREACH_VAL_IND(containers, row)
+	{
+		if (!(value = zend_hash_get_current_data_ex(values, &pos))) {
+			break;
+		}
+		zend_hash_move_forward_ex(values, &pos);
+		scatter_row(&proxy, row, value);
+	}
+	ZEND_HASH_FOREACH_END();
+}
+
+/*
+ * Read the proxied value, or the buffered one of a deferring proxy, into
+ * \a return_value, which shares the storage of the proxied property.
+ */
+static inline zval *get_proxy_value(php_property_proxy_t *proxy,
+		zval *return_value)
+{
+	/* a weak proxy stops caching, when its container is gone */
+	check_weak(proxy);
+	if (proxy->deferred) {
+		ZVAL_COPY(return_value, Z_REFVAL(proxy->deferred->buffer));
+	} else if (proxy->caching) {
+		return_value = get_cached_value(proxy, return_value);
+	} else {
+		return_value = get_path_value(proxy, proxy->depth, return_value);
+	}
+
+	return return_value;
+}
+
+ZEND_RESULT_CODE php_property_proxy_json_encode(php_property_proxy_t *proxy,
+		smart_str *buf, int options)
+{
+	zval value;
+
+	ZVAL_UNDEF(&value);
+	get_proxy_value(proxy, &value);
+	if (Z_ISUNDEF(value)) {
+		ZVAL_NULL(&value);
+	}
+
+	JSON_G(error_code) = PHP_JSON_ERROR_NONE;
+	php_json_encode(buf, &value, options);
+	zval_ptr_dtor(&value);
+
+	return JSON_G(error_code) == PHP_JSON_ERROR_NONE ? SUCCESS : FAILURE;
+}
+
+/*
+ * Serialize the proxied value instead of the property proxy, sharing the
+ * back references of the enclosing serialize() call.
+ */
+static int serialize_obj(zval *object, unsigned char **buffer, size_t *buf_len,
+		zend_serialize_data *data)
+{
+	php_property_proxy_object_t *obj = get_propro(object);
+	php_serialize_data_t var_hash = (php_serialize_data_t) data;
+	smart_str buf = {0};
+	zval value;
+
+	if (!obj->proxy) {
+		php_error(E_WARNING, "Property proxy is not initialized");
+		return FAILURE;
+	}
+
+	ZVAL_UNDEF(&value);
+	get_proxy_value(obj->proxy, &value);
+	if (Z_ISUNDEF(value)) {
+		ZVAL_NULL(&value);
+	}
+	php_var_serialize(&buf, &value, &var_hash);
+	zval_ptr_dtor(&value);
+
+	/* hand over the allocation of the string, which the caller efree()s,
+	 * instead of copying the payload into another one */
+	*buf_len = ZSTR_LEN(buf.s);
+	*buffer = (unsigned char *) buf.s;
+	memmove(*buffer, ZSTR_VAL(buf.s), *buf_len);
+	(*buffer)[*buf_len] = '\0';
+
+	return SUCCESS;
+}
+
+/*
+ * Restore a property proxy of the property "value" of a new stdClass
+ * holding the unserialized value, since the original container is gone.
+ */
+static int unserialize_obj(zval *object, zend_class_entry *ce,
+		const unsigned char *buf, size_t buf_len, zend_unserialize_data *data)
+{
+	php_unserialize_data_t *var_hash = (php_unserialize_data_t *) data;
+	php_property_proxy_object_t *obj;
+	const unsigned char *pos = buf;
+	zval *value, holder, zmember;
+
+	value = var_tmp_var(var_hash);
+	if (!php_var_unserialize(value, &pos, buf + buf_len, var_hash)) {
+		return FAILURE;
+	}
+
+	object_init(&holder);
+	add_property_zval(&holder, "value", value);
+
+	object_init_ex(object, ce);
+	obj = get_propro(object);
+	init_proxy(get_storage(obj), &holder, 1);
+	ZVAL_STRINGL(&zmember, "value", sizeof("value")-1);
+	init_member(get_storage(obj), &zmember);
+	zval_ptr_dtor(&zmember);
+	obj->proxy = get_storage(obj);
+	zval_ptr_dtor(&holder);
+
+	return SUCCESS;
+}
+
+static zval *get_proxied_value(zval *object, zval *return_value)
+{
+	php_property_proxy_object_t *obj = get_propro(object);
+
+	debug_propro(1, "get", obj, NULL, NULL, NULL);
+
+	if (obj->proxy) {
+		return_value = get_proxy_value(obj->proxy, return_value);
+	}
+
+	debug_propro(-1, "get", obj, NULL, NULL, return_value);
+
+	return return_value;
+}
+
+static void set_proxied_value(zval *object, zval *value)
+{
+	php_property_proxy_object_t *obj = get_propro(object);
+
+	debug_propro(1, "set", obj, NULL, NULL, value);
+
+	if (obj->proxy) {
+		/* protect the value while writing it */
+		ZVAL_DEREF(value);
+		Z_TRY_ADDREF_P(value);
+
+		if (obj->proxy->deferred) {
+			zval garbage, *buffer = Z_REFVAL(obj->proxy->deferred->buffer);
+
+			ZVAL_COPY_VALUE(&garbage, buffer);
+			ZVAL_COPY(buffer, value);
+			zval_ptr_dtor(&garbage);
+			invalidate(get_generation(&obj->proxy->deferred->buffer));
+		} else {
+			write_path_value(obj->proxy, obj->proxy->depth - 1,
+					&obj->proxy->path[obj->proxy->depth - 1], value);
+		}
+
+		Z_TRY_DELREF_P(value);
+
+		debug_propro(0, "set", obj, NULL, NULL, value);
+	}
+
+	debug_propro(-1, "set", obj, NULL, NULL, value);
+}
+
+static zval *read_dimension(zval *object, zval *offset, int type, zval *return_value)
+{
+	zval *value, tmp, key;
+
+	debug_propro(1, type == BP_VAR_R ? "dim_r" : "dim_R",
+			get_propro(object), NULL, offset, NULL);
+
+	if (type == BP_VAR_R || type == BP_VAR_IS) {
+		ZEND_ASSERT(offset);
+
+		ZVAL_UNDEF(return_value);
+		ZVAL_UNDEF(&tmp);
+		value = get_proxied_value(object, &tmp);
+		if (!Z_ISUNDEF_P(value)) {
+			init_key(&key, offset);
+			get_container_value(value, &key, return_value);
+			zval_ptr_dtor(&key);
+		}
+		zval_ptr_dtor(&tmp);
+
+		if (Z_ISUNDEF_P(return_value)) {
+			return_value = &EG(uninitialized_zval);
+		}
+	} else if (get_propro(object)->proxy && offset) {
+		RETVAL_OBJ(get_child_object(get_propro(object)->proxy, offset));
+
+		debug_propro(0, "dim_R pp", get_propro(object), NULL, offset, return_value);
+	} else if (get_propro(object)->proxy) {
+		php_property_proxy_object_t *proxy_obj;
+
+		/* appends get a new key each time, so they are not interned */
+		ZVAL_UNDEF(&tmp);
+		value = get_proxied_value(object, &tmp);
+		ZVAL_DEREF(value);
+		if (Z_TYPE_P(value) == IS_ARRAY) {
+			ZVAL_LONG(&key, zend_hash_next_free_element(Z_ARRVAL_P(value)));
+		} else {
+			ZVAL_LONG(&key, 0);
+		}
+		zval_ptr_dtor(&tmp);
+
+		proxy_obj = new_child_object(get_propro(object)->proxy, &key);
+		RETVAL_OBJ(&proxy_obj->zo);
+
+		debug_propro(0, "dim_R pp", get_propro(object), NULL, offset, return_value);
+	}
+
+	debug_propro(-1, type == BP_VAR_R ? "dim_r" : "dim_R",
+			get_propro(object), NULL, offset, return_value);
+
+	return return_value;
+}
+
+static int has_dimension(zval *object, zval *offset, int check_empty)
+{
+	php_property_proxy_t *native = get_native_proxy(object);
+	zval *value, tmp;
+	int exists = 0;
+
+	debug_propro(1, "dim_e", get_propro(object), NULL, offset, NULL);
+
+	if (native && native->ops->has) {
+		zval key;
+
+		init_key(&key, offset);
+		exists = native->ops->has(native->data, &native->path[0], &key, check_empty);
+		zval_ptr_dtor(&key);
+
+		debug_propro(-1, "dim_e", get_propro(object), NULL, offset, NULL);
+		return exists;
+	}
+
+	ZVAL_UNDEF(&tmp);
+	value = get_proxied_value(object, &tmp);
+
+	if (!Z_ISUNDEF_P(value)) {
+		ZVAL_DEREF(value);
+		if (Z_TYPE_P(value) == IS_ARRAY) {
+			zval key, *zentry;
+
+			init_key(&key, offset);
+			zentry = find_key(Z_ARRVAL_P(value), &key);
+			zval_ptr_dtor(&key);
+
+			if (zentry) {
+				if (check_empty) {
+					exists = !Z_ISNULL_P(zentry);
+				} else {
+					exists = 1;
+				}
+			}
+		}
+	}
+	zval_ptr_dtor(&tmp);
+
+	debug_propro(-1, "dim_e", get_propro(object), NULL, offset, NULL);
+
+	return exists;
+}
+
+static void write_dimension(zval *object, zval *offset, zval *input_value)
+{
+	php_property_proxy_object_t *obj = get_propro(object);
+
+	debug_propro(1, "dim_w", obj, NULL, offset, input_value);
+
+	if (obj->proxy) {
+		zval key;
+
+		if (offset) {
+			init_key(&key, offset);
+		}
+		write_path_value(obj->proxy, obj->proxy->depth, offset ? &key : NULL,
+				input_value);
+		if (offset) {
+			zval_ptr_dtor(&key);
+		}
+	}
+
+	debug_propro(-1, "dim_w", obj, NULL, offset, input_value);
+}
+
+static void unset_dimension(zval *object, zval *offset)
+{
+	php_property_proxy_object_t *obj = get_propro(object);
+	php_property_proxy_t *native = get_native_proxy(object);
+	zval *value, tmp;
+	int type;
+
+	debug_propro(1, "dim_u", obj, NULL, offset, NULL);
+
+	if (native && native->ops->unset) {
+		zval key;
+
+		init_key(&key, offset);
+		journal_change(native, 1, &key);
+		native->ops->unset(native->data, &native->path[0], &key);
+		invalidate(get_generation(&native->container));
+		zval_ptr_dtor(&key);
+
+		debug_propro(-1, "dim_u", obj, NULL, offset, NULL);
+		return;
+	}
+
+	ZVAL_UNDEF(&tmp);
+	value = get_proxied_value(object, &tmp);
+	ZVAL_DEREF(value);
+	type = Z_TYPE_P(value);
+	/* do not force write_begin() to separate the value */
+	zval_ptr_dtor(&tmp);
+
+	if (type == IS_ARRAY) {
+		php_property_proxy_write_t w;
+		zval key, *array;
+
+		init_key(&key, offset);
+		array = write_begin(&w, obj->proxy, obj->proxy->depth);
+		if (Z_TYPE_P(array) == IS_ARRAY) {
+			journal_change(obj->proxy, obj->proxy->depth, &key);
+			unset_container_value(array, &key);
+		}
+		write_end(&w);
+		zval_ptr_dtor(&key);
+	}
+
+	debug_propro(-1, "dim_u", obj, NULL, offset, NULL);
+}
+
+/*
+ * The property handlers forward to the members of the proxied value, so
+ * that chained property access works like chained dimension access.
+ */
+static zval *read_property(zval *object, zval *member, int type, void **cache_slot,
+		zval *return_value)
+{
+	php_property_proxy_object_t *obj = get_propro(object);
+	zval *value, tmp, key;
+
+	debug_propro(1, type == BP_VAR_R ? "prop_r" : "prop_R", obj, NULL, NULL, NULL);
+
+	if (type == BP_VAR_R || type == BP_VAR_IS) {
+		ZVAL_UNDEF(return_value);
+		ZVAL_UNDEF(&tmp);
+		value = get_proxied_value(object, &tmp);
+		if (!Z_ISUNDEF_P(value)) {
+			init_key(&key, member);
+			get_container_value(value, &key, return_value);
+			zval_ptr_dtor(&key);
+		}
+		zval_ptr_dtor(&tmp);
+
+		if (Z_ISUNDEF_P(return_value)) {
+			return_value = &EG(uninitialized_zval);
+		}
+	} else if (obj->proxy) {
+		RETVAL_OBJ(get_child_object(obj->proxy, member));
+	} else {
+		return_value = &EG(error_zval);
+	}
+
+	debug_propro(-1, type == BP_VAR_R ? "prop_r" : "prop_R", obj, NULL, NULL,
+			return_value);
+
+	return return_value;
+}
+
+#if PHP_VERSION_ID >= 70400
+static zval *write_property(zval *object, zval *member, zval *value, void **cache_slot)
+{
+	write_dimension(object, member, value);
+	return value;
+}
+#else
+static void write_property(zval *object, zval *member, zval *value, void **cache_slot)
+{
+	write_dimension(object, member, value);
+}
+#endif
+
+/*
+ * Writes through chained properties go through child proxies created by
+ * read_property(), so that values of containers without property slots
+ * are written back.
+ */
+static zval *get_property_ptr_ptr(zval *object, zval *member, int type,
+		void **cache_slot)
+{
+	return NULL;
+}
+
+static int has_property(zval *object, zval *member, int has_set_exists,
+		void **cache_slot)
+{
+	php_property_proxy_t *native = get_native_proxy(object);
+	zval *value, tmp, key, *zentry = NULL;
+	int exists = 0;
+
+	debug_propro(1, "prop_e", get_propro(object), NULL, NULL, NULL);
+
+	if (native && native->ops->has && has_set_exists < 2) {
+		init_key(&key, member);
+		exists = native->ops->has(native->data, &native->path[0], &key, has_set_exists);
+		zval_ptr_dtor(&key);
+
+		debug_propro(-1, "prop_e", get_propro(object), NULL, NULL, NULL);
+		return exists;
+	}
+
+	ZVAL_UNDEF(&tmp);
+	value = get_proxied_value(object, &tmp);
+	ZVAL_DEREF(value);
+
+	switch (Z_TYPE_P(value)) {
+	case IS_OBJECT:
+		if (Z_OBJ_HT_P(value)->has_property) {
+			zend_class_entry *scope = swap_scope(Z_OBJCE_P(value));
+
+			exists = Z_OBJ_HT_P(value)->has_property(value, member,
+					has_set_exists, NULL);
+			swap_scope(scope);
+		}
+		break;
+
+	case IS_ARRAY:
+		init_key(&key, member);
+		zentry = find_key(Z_ARRVAL_P(value), &key);
+		zval_ptr_dtor(&key);
+
+		if (zentry) {
+			ZVAL_DEREF(zentry);
+			switch (has_set_exists) {
+			case 0:
+				exists = !Z_ISNULL_P(zentry);
+				break;
+			case 1:
+				exists = zend_is_true(zentry);
+				break;
+			default:
+				exists = 1;
+				break;
+			}
+		}
+		break;
+	}
+	zval_ptr_dtor(&tmp);
+
+	debug_propro(-1, "prop_e", get_propro(object), NULL, NULL, NULL);
+
+	return exists;
+}
+
+static void unset_property(zval *object, zval *member, void **cache_slot)
+{
+	php_property_proxy_object_t *obj = get_propro(object);
+	php_property_proxy_t *native = get_native_proxy(object);
+	zval *value, tmp;
+	int type;
+
+	debug_propro(1, "prop_u", obj, NULL, NULL, NULL);
+
+	if (native && native->ops->unset) {
+		zval key;
+
+		init_key(&key, member);
+		journal_change(native, 1, &key);
+		native->ops->unset(native->data, &native->path[0], &key);
+		invalidate(get_generation(&native->container));
+		zval_ptr_dtor(&key);
+
+		debug_propro(-1, "prop_u", obj, NULL, NULL, NULL);
+		return;
+	}
+
+	ZVAL_UNDEF(&tmp);
+	value = get_proxied_value(object, &tmp);
+	ZVAL_DEREF(value);
+	type = Z_TYPE_P(value);
+	/* do not force write_begin() to separate the value */
+	zval_ptr_dtor(&tmp);
+
+	if (type == IS_ARRAY || type == IS_OBJECT) {
+		php_property_proxy_write_t w;
+		zval key, *container;
+
+		init_key(&key, member);
+		journal_change(obj->proxy, obj->proxy->depth, &key);
+		container = write_begin(&w, obj->proxy, obj->proxy->depth);
+		unset_container_value(container, &key);
+		write_end(&w);
+		zval_ptr_dtor(&key);
+	}
+
+	debug_propro(-1, "prop_u", obj, NULL, NULL, NULL);
+}
+
+/*
+ * Count the proxied array or countable object without copying it; a proxy
+ * of an unset property counts zero elements.
+ */
+static int count_elements(zval *object, zend_long *count)
+{
+	php_property_proxy_t *native = get_native_proxy(object);
+	zval *value, tmp;
+	int rc = FAILURE;
+
+	debug_propro(1, "count", get_propro(object), NULL, NULL, NULL);
+
+	if (native && native->ops->count) {
+		rc = native->ops->count(native->data, &native->path[0], count);
+
+		debug_propro(-1, "count", get_propro(object), NULL, NULL, NULL);
+		return rc;
+	}
+
+	ZVAL_UNDEF(&tmp);
+	value = get_proxied_value(object, &tmp);
+	ZVAL_DEREF(value);
+
+	switch (Z_TYPE_P(value)) {
+	case IS_UNDEF:
+	case IS_NULL:
+		*count = 0;
+		rc = SUCCESS;
+		break;
+
+	case IS_ARRAY:
+		*count = zend_hash_num_elements(Z_ARRVAL_P(value));
+		rc = SUCCESS;
+		break;
+
+	case IS_OBJECT:
+		if (Z_OBJ_HT_P(value)->count_elements) {
+			rc = Z_OBJ_HT_P(value)->count_elements(value, count);
+		}
+		if (rc != SUCCESS && instanceof_function(Z_OBJCE_P(value), zend_ce_countable)) {
+			zval retval;
+
+			ZVAL_UNDEF(&retval);
+			zend_call_method_with_0_params(value, Z_OBJCE_P(value), NULL, "count", &retval);
+			if (!Z_ISUNDEF(retval)) {
+				*count = zval_get_long(&retval);
+				zval_ptr_dtor(&retval);
+				rc = SUCCESS;
+			}
+		}
+		break;
+	}
+	zval_ptr_dtor(&tmp);
+
+	debug_propro(-1, "count", get_propro(object), NULL, NULL, NULL);
+
+	return rc;
+}
+
+typedef struct php_property_proxy_iterator {
+	zend_object_iterator zi;
+	/** The iterated array or object, a reference to it if iterated by-ref */
+	zval value;
+	/** The index of the hash table iterator */
+	uint32_t ht_iter;
+	/** Whether w holds the pending write backs of by-ref iteration */
+	zend_bool by_ref;
+	php_property_proxy_write_t w;
+} php_property_proxy_iterator_t;
+
+static HashTable *get_iterator_ht(php_property_proxy_iterator_t *it,
+		HashPosition *pos)
+{
+	zval *value = &it->value;
+	HashTable *ht;
+
+	if (it->ht_iter == (uint32_t) -1) {
+		return NULL;
+	}
+
+	ZVAL_DEREF(value);
+	switch (Z_TYPE_P(value)) {
+	case IS_ARRAY:
+		if (it->by_ref) {
+			/* like FE_FETCH_RW, which separates the array if necessary */
+			*pos = zend_hash_iterator_pos_ex(it->ht_iter, value);
+			return Z_ARRVAL_P(value);
+		}
+		ht = Z_ARRVAL_P(value);
+		break;
+
+	case IS_OBJECT:
+		if (!(ht = Z_OBJ_HT_P(value)->get_properties(value))) {
+			return NULL;
+		}
+		break;
+
+	default:
+		return NULL;
+	}
+
+	*pos = zend_hash_iterator_pos(it->ht_iter, ht);
+	return ht;
+}
+
+/*
+ * Get the current entry, skipping uninitialized and non-public properties.
+ */
+static zval *get_iterator_data(php_property_proxy_iterator_t *it)
+{
+	HashPosition pos;
+	HashTable *ht = get_iterator_ht(it, &pos);
+	zval *value = &it->value, *data = NULL;
+
+	if (!ht) {
+		return NULL;
+	}
+
+	ZVAL_DEREF(value);
+	while ((data = zend_hash_get_current_data_ex(ht, &pos))) {
+		if (Z_TYPE_P(data) == IS_INDIRECT) {
+			data = Z_INDIRECT_P(data);
+		}
+		if (!Z_ISUNDEF_P(data)) {
+			zend_string *name;
+			zend_ulong index;
+
+			if (Z_TYPE_P(value) != IS_OBJECT) {
+				break;
+			}
+			/* mangled names of private and protected properties start with NUL */
+			if (HASH_KEY_IS_STRING != zend_hash_get_current_key_ex(ht, &name, &index, &pos)
+			||	!name->len || name->val[0]) {
+				break;
+			}
+		}
+		zend_hash_move_forward_ex(ht, &pos);
+	}
+	EG(ht_iterators)[it->ht_iter].pos = pos;
+
+	return data;
+}
+
+static void iterator_dtor(zend_object_iterator *iter)
+{
+	php_property_proxy_iterator_t *it = (php_property_proxy_iterator_t *) iter;
+
+	if (it->ht_iter != (uint32_t) -1) {
+		zend_hash_iterator_del(it->ht_iter);
+	}
+	if (it->by_ref) {
+		write_end(&it->w);
+	}
+	zval_ptr_dtor(&it->value);
+	zval_ptr_dtor(&it->zi.data);
+}
+
+static int iterator_valid(zend_object_iterator *iter)
+{
+	php_property_proxy_iterator_t *it = (php_property_proxy_iterator_t *) iter;
+
+	return get_iterator_data(it) ? SUCCESS : FAILURE;
+}
+
+static zval *iterator_current_data(zend_object_iterator *iter)
+{
+	php_property_proxy_iterator_t *it = (php_property_proxy_iterator_t *) iter;
+
+	return get_iterator_data(it);
+}
+
+static void iterator_current_key(zend_object_iterator *iter, zval *key)
+{
+	php_property_proxy_iterator_t *it = (php_property_proxy_iterator_t *) iter;
+	HashPosition pos;
+	HashTable *ht = get_iterator_ht(it, &pos);
+
+	if (ht) {
+		zend_hash_get_current_key_zval_ex(ht, key, &pos);
+	} else {
+		ZVAL_NULL(key);
+	}
+}
+
+static void iterator_move_forward(zend_object_iterator *iter)
+{
+	php_property_proxy_iterator_t *it = (php_property_proxy_iterator_t *) iter;
+	HashPosition pos;
+	HashTable *ht = get_iterator_ht(it, &pos);
+
+	if (ht) {
+		zend_hash_move_forward_ex(ht, &pos);
+		EG(ht_iterators)[it->ht_iter].pos = pos;
+	}
+}
+
+static void iterator_rewind(zend_object_iterator *iter)
+{
+	php_property_proxy_iterator_t *it = (php_property_proxy_iterator_t *) iter;
+	HashPosition pos;
+	HashTable *ht = get_iterator_ht(it, &pos);
+
+	if (ht) {
+		zend_hash_internal_pointer_reset_ex(ht, &pos);
+		EG(ht_iterators)[it->ht_iter].pos = pos;
+	}
+}
+
+static zend_object_iterator_funcs php_property_proxy_iterator_funcs = {
+	iterator_dtor,
+	iterator_valid,
+	iterator_current_data,
+	iterator_current_key,
+	iterator_move_forward,
+	iterator_rewind,
+	NULL
+};
+
+/*
+ * Iterate the proxied array or object properties in place; by-ref iteration
+ * makes the proxied property a reference, like foreach does with variables.
+ * Traversable objects provide their own iterators.
+ */
+static zend_object_iterator *get_iterator(zend_class_entry *ce, zval *object,
+		int by_ref)
+{
+	php_property_proxy_object_t *obj = get_propro(object);
+	php_property_proxy_t *native = get_native_proxy(object);
+	php_property_proxy_iterator_t *it;
+	zval *value, tmp;
+
+	if (native && native->ops->iterate) {
+		return native->ops->iterate(native->data, &native->path[0], object, by_ref);
+	}
+
+	debug_propro(1, "iter", obj, NULL, NULL, NULL);
+
+	it = ecalloc(1, sizeof(*it));
+	ZVAL_UNDEF(&it->value);
+	if (by_ref && obj->proxy) {
+		php_property_proxy_t *proxy = obj->proxy;
+
+		if (proxy->deferred) {
+			write_init(&it->w, proxy, &proxy->deferred->buffer, 0);
+			value = &proxy->deferred->buffer;
+		} else {
+			zval *container;
+
+			journal_change(proxy, proxy->depth - 1, &proxy->path[proxy->depth - 1]);
+			container = write_begin(&it->w, proxy, proxy->depth - 1);
+
+			value = write_slot(&it->w, container, &proxy->path[proxy->depth - 1]);
+		}
+		separate_slot(value);
+		ZVAL_MAKE_REF(value);
+		ZVAL_COPY(&it->value, value);
+		it->by_ref = 1;
+	} else {
+		get_proxied_value(object, &it->value);
+	}
+
+	value = &it->value;
+	ZVAL_DEREF(value);
+	if (Z_TYPE_P(value) == IS_OBJECT && Z_OBJCE_P(value)->get_iterator) {
+		zend_object_iterator *iter;
+
+		ZVAL_COPY(&tmp, value);
+		if (it->by_ref) {
+			write_end(&it->w);
+		}
+		zval_ptr_dtor(&it->value);
+		efree(it);
+
+		iter = Z_OBJCE(tmp)->get_iterator(Z_OBJCE(tmp), &tmp, by_ref);
+		zval_ptr_dtor(&tmp);
+
+		debug_propro(-1, "iter", obj, NULL, NULL, NULL);
+		return iter;
+	}
+
+	zend_iterator_init(&it->zi);
+	ZVAL_COPY(&it->zi.data, object);
+	it->zi.funcs = &php_property_proxy_iterator_funcs;
+	it->ht_iter = (uint32_t) -1;
+	if (Z_TYPE_P(value) == IS_ARRAY) {
+		it->ht_iter = zend_hash_iterator_add(Z_ARRVAL_P(value), 0);
+	} else if (Z_TYPE_P(value) == IS_OBJECT) {
+		HashTable *props = Z_OBJ_HT_P(value)->get_properties(value);
+
+		if (props) {
+			it->ht_iter = zend_hash_iterator_add(props, 0);
+		}
+	}
+
+	debug_propro(-1, "iter", obj, NULL, NULL, &it->value);
+
+	return &it->zi;
+}
+
+ZEND_BEGIN_ARG_INFO_EX(ai_propro_construct, 0, 0, 2)
+	ZEND_ARG_INFO(0, object)
+	ZEND_ARG_INFO(0, member)
+	ZEND_ARG_OBJ_INFO(0, parent, php\\PropertyProxy, 1)
+ZEND_END_ARG_INFO();
+static PHP_METHOD(propro, __construct) {
+	zend_error_handling zeh;
+	zval *reference, *parent = NULL;
+	zend_string *member;
+
+	zend_replace_error_handling(EH_THROW, NULL, &zeh);
+	if (SUCCESS == zend_parse_parameters(ZEND_NUM_ARGS(), "o!S|O!",
+			&reference, &member, &parent,
+			php_property_proxy_class_entry)) {
+		php_property_proxy_object_t *obj;
+
+		obj = get_propro(getThis());
+
+		if (parent) {
+			php_property_proxy_object_t *parent_obj = get_propro(parent);
+
+			if (parent_obj->proxy) {
+				zval zmember;
+
+				ZVAL_STR(&zmember, member);
+				init_proxy_child(get_storage(obj), parent_obj->proxy, &zmember);
+				obj->proxy = get_storage(obj);
+				if (obj->proxy->untracked) {
+					untrack_object(&obj->zo, 1);
+				}
+			} else {
+				php_error(E_WARNING, "Parent is not initialized");
+			}
+		} else if (reference) {
+			zval zmember;
+
+			init_proxy(get_storage(obj), reference, 1);
+			ZVAL_STR(&zmember, member);
+			init_member(get_storage(obj), &zmember);
+			obj->proxy = get_storage(obj);
+		} else {
+			php_error(E_WARNING, "Either object or parent must be set");
+		}
+	}
+	zend_restore_error_handling(&zeh);
+}
+
+ZEND_BEGIN_ARG_INFO_EX(ai_propro_assign, 0, 0, 1)
+	ZEND_ARG_ARRAY_INFO(0, values, 0)
+ZEND_END_ARG_INFO();
+static PHP_METHOD(propro, assign) {
+	zend_error_handling zeh;
+	HashTable *values;
+
+	zend_replace_error_handling(EH_THROW, NULL, &zeh);
+	if (SUCCESS == zend_parse_parameters(ZEND_NUM_ARGS(), "h", &values)) {
+		php_property_proxy_object_t *obj = get_propro(getThis());
+
+		if (obj->proxy) {
+			php_property_proxy_write_many(obj->proxy, values, NULL);
+		} else {
+			php_error(E_WARNING, "Property proxy is not initialized");
+		}
+	}
+	zend_restore_error_handling(&zeh);
+}
+
+ZEND_BEGIN_ARG_INFO_EX(ai_propro_remove, 0, 0, 1)
+	ZEND_ARG_ARRAY_INFO(0, keys, 0)
+ZEND_END_ARG_INFO();
+static PHP_METHOD(propro, remove) {
+	zend_error_handling zeh;
+	HashTable *keys;
+
+	zend_replace_error_handling(EH_THROW, NULL, &zeh);
+	if (SUCCESS == zend_parse_parameters(ZEND_NUM_ARGS(), "h", &keys)) {
+		php_property_proxy_object_t *obj = get_propro(getThis());
+
+		if (obj->proxy) {
+			php_property_proxy_write_many(obj->proxy, NULL, keys);
+		} else {
+			php_error(E_WARNING, "Property proxy is not initialized");
+		}
+	}
+	zend_restore_error_handling(&zeh);
+}
+
+ZEND_BEGIN_ARG_INFO_EX(ai_propro_defer, 0, 0, 0)
+ZEND_END_ARG_INFO();
+static PHP_METHOD(propro, defer) {
+	zend_error_handling zeh;
+
+	zend_replace_error_handling(EH_THROW, NULL, &zeh);
+	if (SUCCESS == zend_parse_parameters_none()) {
+		php_property_proxy_object_t *obj = get_propro(getThis());
+
+		if (obj->proxy) {
+			php_property_proxy_defer(obj->proxy);
+		} else {
+			php_error(E_WARNING, "Property proxy is not initialized");
+		}
+	}
+	zend_restore_error_handling(&zeh);
+}
+
+ZEND_BEGIN_ARG_INFO_EX(ai_propro_commit, 0, 0, 0)
+ZEND_END_ARG_INFO();
+static PHP_METHOD(propro, commit) {
+	zend_error_handling zeh;
+
+	zend_replace_error_handling(EH_THROW, NULL, &zeh);
+	if (SUCCESS == zend_parse_parameters_none()) {
+		php_property_proxy_object_t *obj = get_propro(getThis());
+
+		if (obj->proxy) {
+			php_property_proxy_commit(obj->proxy);
+		}
+	}
+	zend_restore_error_handling(&zeh);
+}
+
+ZEND_BEGIN_ARG_INFO_EX(ai_propro_cache, 0, 0, 0)
+	ZEND_ARG_INFO(0, enable)
+ZEND_END_ARG_INFO();
+static PHP_METHOD(propro, cache) {
+	zend_error_handling zeh;
+	zend_bool enable = 1;
+
+	zend_replace_error_handling(EH_THROW, NULL, &zeh);
+	if (SUCCESS == zend_parse_parameters(ZEND_NUM_ARGS(), "|b", &enable)) {
+		php_property_proxy_object_t *obj = get_propro(getThis());
+
+		if (obj->proxy) {
+			php_property_proxy_cache(obj->proxy, enable);
+		} else {
+			php_error(E_WARNING, "Property proxy is not initialized");
+		}
+	}
+	zend_restore_error_handling(&zeh);
+}
+
+ZEND_BEGIN_ARG_INFO_EX(ai_propro_journal, 0, 0, 1)
+	ZEND_ARG_INFO(0, container)
+	ZEND_ARG_INFO(0, enable)
+ZEND_END_ARG_INFO();
+static PHP_METHOD(propro, journal) {
+	zend_error_handling zeh;
+	zend_bool enable = 1;
+	zval *container;
+
+	zend_replace_error_handling(EH_THROW, NULL, &zeh);
+	if (SUCCESS == zend_parse_parameters(ZEND_NUM_ARGS(), "o|b", &container, &enable)) {
+		php_property_proxy_journal(container, enable);
+	}
+	zend_restore_error_handling(&zeh);
+}
+
+ZEND_BEGIN_ARG_INFO_EX(ai_propro_changes, 0, 0, 1)
+	ZEND_ARG_INFO(0, container)
+ZEND_END_ARG_INFO();
+static PHP_METHOD(propro, changes) {
+	zend_error_handling zeh;
+	zval *container;
+
+	zend_replace_error_handling(EH_THROW, NULL, &zeh);
+	if (SUCCESS == zend_parse_parameters(ZEND_NUM_ARGS(), "o", &container)) {
+		HashTable *changes = php_property_proxy_changes(container);
+		zval *path;
+
+		if (changes) {
+			array_init_size(return_value, zend_hash_num_elements(changes));
+			ZEND_HASH_FOREACH_VAL(changes, path)
+			{
+				Z_ADDREF_P(path);
+				add_next_index_zval(return_value, path);
+			}
+			ZEND_HASH_FOREACH_END();
+		} else {
+			php_error(E_WARNING, "Changes of the container are not journaled");
+		}
+	}
+	zend_restore_error_handling(&zeh);
+}
+
+ZEND_BEGIN_ARG_INFO_EX(ai_propro_clearChanges, 0, 0, 1)
+	ZEND_ARG_INFO(0, container)
+ZEND_END_ARG_INFO();
+static PHP_METHOD(propro, clearChanges) {
+	zend_error_handling zeh;
+	zval *container;
+
+	zend_replace_error_handling(EH_THROW, NULL, &zeh);
+	if (SUCCESS == zend_parse_parameters(ZEND_NUM_ARGS(), "o", &container)) {
+		php_property_proxy_clear_changes(container);
+	}
+	zend_restore_error_handling(&zeh);
+}
+
+ZEND_BEGIN_ARG_INFO_EX(ai_propro_reserve, 0, 0, 1)
+	ZEND_ARG_INFO(0, n)
+	ZEND_ARG_INFO(0, packed)
+ZEND_END_ARG_INFO();
+static PHP_METHOD(propro, reserve) {
+	zend_error_handling zeh;
+	zend_long n;
+	zend_bool packed = 1;
+
+	zend_replace_error_handling(EH_THROW, NULL, &zeh);
+	if (SUCCESS == zend_parse_parameters(ZEND_NUM_ARGS(), "l|b", &n, &packed)) {
+		php_property_proxy_object_t *obj = get_propro(getThis());
+
+		if (n < 0 || n >= HT_MAX_SIZE) {
+			php_error(E_WARNING, "Capacity must be between 0 and %u",
+					(unsigned) HT_MAX_SIZE - 1);
+		} else if (obj->proxy) {
+			php_property_proxy_reserve(obj->proxy, n, packed);
+		} else {
+			php_error(E_WARNING, "Property proxy is not initialized");
+		}
+	}
+	zend_restore_error_handling(&zeh);
+}
+
+ZEND_BEGIN_ARG_INFO_EX(ai_propro_untrack, 0, 0, 0)
+	ZEND_ARG_INFO(0, enable)
+ZEND_END_ARG_INFO();
+static PHP_METHOD(propro, untrack) {
+	zend_error_handling zeh;
+	zend_bool enable = 1;
+
+	zend_replace_error_handling(EH_THROW, NULL, &zeh);
+	if (SUCCESS == zend_parse_parameters(ZEND_NUM_ARGS(), "|b", &enable)) {
+		php_property_proxy_object_t *obj = get_propro(getThis());
+
+		if (obj->proxy) {
+			php_property_proxy_untrack(obj->proxy, enable);
+			untrack_object(&obj->zo, enable);
+		} else {
+			php_error(E_WARNING, "Property proxy is not initialized");
+		}
+	}
+	zend_restore_error_handling(&zeh);
+}
+
+ZEND_BEGIN_ARG_INFO_EX(ai_propro_weaken, 0, 0, 0)
+ZEND_END_ARG_INFO();
+static PHP_METHOD(propro, weaken) {
+	zend_error_handling zeh;
+
+	zend_replace_error_handling(EH_THROW, NULL, &zeh);
+	if (SUCCESS == zend_parse_parameters_none()) {
+		php_property_proxy_object_t *obj = get_propro(getThis());
+
+		if (!obj->proxy) {
+			php_error(E_WARNING, "Property proxy is not initialized");
+		} else if (SUCCESS != php_property_proxy_weaken(obj->proxy)) {
+			php_error(E_WARNING, "Container cannot be weakly referenced");
+		}
+	}
+	zend_restore_error_handling(&zeh);
+}
+
+ZEND_BEGIN_ARG_INFO_EX(ai_propro_jsonSerialize, 0, 0, 0)
+ZEND_END_ARG_INFO();
+static PHP_METHOD(propro, jsonSerialize) {
+	zend_error_handling zeh;
+
+	zend_replace_error_handling(EH_THROW, NULL, &zeh);
+	if (SUCCESS == zend_parse_parameters_none()) {
+		php_property_proxy_object_t *obj = get_propro(getThis());
+
+		if (obj->proxy) {
+			get_proxy_value(obj->proxy, return_value);
+			if (Z_ISUNDEF_P(return_value)) {
+				ZVAL_NULL(return_value);
+			}
+		} else {
+			php_error(E_WARNING, "Property proxy is not initialized");
+		}
+	}
+	zend_restore_error_handling(&zeh);
+}
+
+/*
+ * Instantiate a new php\PropertyPath for the compiled \a path.
+ */
+static php_property_proxy_object_t *new_path_object(zend_class_entry *ce,
+		php_property_proxy_t *path)
+{
+	php_property_proxy_object_t *o;
+
+	o = php_property_proxy_object_new_ex(ce ? ce : php_property_path_class_entry, path);
+	o->zo.handlers = &php_property_path_object_handlers;
+
+	return o;
+}
+
+static zend_object *path_object_new(zend_class_entry *ce)
+{
+	return &new_path_object(ce, NULL)->zo;
+}
+
+ZEND_BEGIN_ARG_INFO_EX(ai_propro_compile, 0, 0, 1)
+	ZEND_ARG_INFO(0, path)
+ZEND_END_ARG_INFO();
+static PHP_METHOD(propro, compile) {
+	zend_error_handling zeh;
+	zend_string *path;
+
+	zend_replace_error_handling(EH_THROW, NULL, &zeh);
+	if (SUCCESS == zend_parse_parameters(ZEND_NUM_ARGS(), "S", &path)) {
+		php_property_proxy_t *proxy = php_property_proxy_compile(path->val, path->len);
+
+		if (proxy) {
+			RETVAL_OBJ(&new_path_object(NULL, proxy)->zo);
+		} else {
+			php_error(E_WARNING, "Invalid property path '%s'", path->val);
+		}
+	}
+	zend_restore_error_handling(&zeh);
+}
+
+/*
+ * Get the compiled path of a path string, a list of keys or a
+ * php\PropertyPath; \a owned tells whether the caller has to free it.
+ */
+static php_property_proxy_t *get_path_arg(zval *zpath, zend_bool *owned)
+{
+	*owned = 1;
+	switch (Z_TYPE_P(zpath)) {
+	case IS_STRING:
+		return php_property_proxy_compile(Z_STRVAL_P(zpath), Z_STRLEN_P(zpath));
+
+	case IS_ARRAY:
+		return compile_keys(Z_ARRVAL_P(zpath));
+
+	case IS_OBJECT:
+		if (instanceof_function(Z_OBJCE_P(zpath), php_property_path_class_entry)) {
+			*owned = 0;
+			return get_propro(zpath)->proxy;
+		}
+		break;
+	}
+	return NULL;
+}
+
+ZEND_BEGIN_ARG_INFO_EX(ai_propro_gather, 0, 0, 2)
+	ZEND_ARG_INFO(0, containers)
+	ZEND_ARG_INFO(0, path)
+ZEND_END_ARG_INFO();
+static PHP_METHOD(propro, gather) {
+	zend_error_handling zeh;
+	zval *containers, *zpath;
+
+	zend_replace_error_handling(EH_THROW, NULL, &zeh);
+	if (SUCCESS == zend_parse_parameters(ZEND_NUM_ARGS(), "zz", &containers, &zpath)) {
+		php_property_proxy_t *path;
+		zend_bool owned;
+
+		if (Z_TYPE_P(containers) != IS_ARRAY
+		&&	(Z_TYPE_P(containers) != IS_OBJECT
+		||	!instanceof_function(Z_OBJCE_P(containers), zend_ce_traversable))) {
+			php_error(E_WARNING, "Containers must be an array or Traversable");
+		} else if (!(path = get_path_arg(zpath, &owned))) {
+			php_error(E_WARNING, "Invalid property path");
+		} else {
+			php_property_proxy_gather(path, containers, return_value);
+			if (owned) {
+				php_property_proxy_free(&path);
+			}
+		}
+	}
+	zend_restore_error_handling(&zeh);
+}
+
+ZEND_BEGIN_ARG_INFO_EX(ai_propro_scatter, 0, 0, 3)
+	ZEND_ARG_ARRAY_INFO(1, containers, 0)
+	ZEND_ARG_INFO(0, path)
+	ZEND_ARG_ARRAY_INFO(0, values, 0)
+ZEND_END_ARG_INFO();
+static PHP_METHOD(propro, scatter) {
+	zend_error_handling zeh;
+	zval *containers, *zpath, *values;
+
+	zend_replace_error_handling(EH_THROW, NULL, &zeh);
+	if (SUCCESS == zend_parse_parameters(ZEND_NUM_ARGS(), "zza", &containers, &zpath, &values)) {
+		php_property_proxy_t *path;
+		zend_bool owned;
+
+		ZVAL_DEREF(containers);
+		if (Z_TYPE_P(containers) != IS_ARRAY) {
+			php_error(E_WARNING, "Containers must be an array");
+		} else if (!(path = get_path_arg(zpath, &owned))) {
+			php_error(E_WARNING, "Invalid property path");
+		} else {
+			zval rows, vals;
+
+			/* keep the rows and values alive, whatever the property handlers do */
+			SEPARATE_ARRAY(containers);
+			ZVAL_COPY(&rows, containers);
+			ZVAL_COPY(&vals, values);
+			php_property_proxy_scatter(path, Z_ARRVAL(rows), Z_ARRVAL(vals));
+			zval_ptr_dtor(&vals);
+			zval_ptr_dtor(&rows);
+			if (owned) {
+				php_property_proxy_free(&path);
+			}
+		}
+	}
+	zend_restore_error_handling(&zeh);
+}
+
+static const zend_function_entry php_property_proxy_method_entry[] = {
+	PHP_ME(propro, __construct, ai_propro_construct, ZEND_ACC_PUBLIC)
+	PHP_ME(propro, assign, ai_propro_assign, ZEND_ACC_PUBLIC)
+	PHP_ME(propro, remove, ai_propro_remove, ZEND_ACC_PUBLIC)
+	PHP_ME(propro, defer, ai_propro_defer, ZEND_ACC_PUBLIC)
+	PHP_ME(propro, commit, ai_propro_commit, ZEND_ACC_PUBLIC)
+	PHP_ME(propro, cache, ai_propro_cache, ZEND_ACC_PUBLIC)
+	PHP_ME(propro, reserve, ai_propro_reserve, ZEND_ACC_PUBLIC)
+	PHP_ME(propro, untrack, ai_propro_untrack, ZEND_ACC_PUBLIC)
+	PHP_ME(propro, weaken, ai_propro_weaken, ZEND_ACC_PUBLIC)
+	PHP_ME(propro, jsonSerialize, ai_propro_jsonSerialize, ZEND_ACC_PUBLIC)
+	PHP_ME(propro, compile, ai_propro_compile, ZEND_ACC_PUBLIC|ZEND_ACC_STATIC)
+	PHP_ME(propro, gather, ai_propro_gather, ZEND_ACC_PUBLIC|ZEND_ACC_STATIC)
+	PHP_ME(propro, scatter, ai_propro_scatter, ZEND_ACC_PUBLIC|ZEND_ACC_STATIC)
+	PHP_ME(propro, journal, ai_propro_journal, ZEND_ACC_PUBLIC|ZEND_ACC_STATIC)
+	PHP_ME(propro, changes, ai_propro_changes, ZEND_ACC_PUBLIC|ZEND_ACC_STATIC)
+	PHP_ME(propro, clearChanges, ai_propro_clearChanges, ZEND_ACC_PUBLIC|ZEND_ACC_STATIC)
+	{0}
+};
+
+ZEND_BEGIN_ARG_INFO_EX(ai_propath_construct, 0, 0, 1)
+	ZEND_ARG_INFO(0, path)
+ZEND_END_ARG_INFO();
+static PHP_METHOD(propath, __construct) {
+	zend_error_handling zeh;
+	zend_string *path;
+
+	zend_replace_error_handling(EH_THROW, NULL, &zeh);
+	if (SUCCESS == zend_parse_parameters(ZEND_NUM_ARGS(), "S", &path)) {
+		php_property_proxy_object_t *obj = get_propro(getThis());
+		php_property_proxy_t *proxy = php_property_proxy_compile(path->val, path->len);
+
+		if (proxy) {
+			php_property_proxy_free(&obj->proxy);
+			obj->proxy = proxy;
+		} else {
+			php_error(E_WARNING, "Invalid property path '%s'", path->val);
+		}
+	}
+	zend_restore_error_handling(&zeh);
+}
+
+ZEND_BEGIN_ARG_INFO_EX(ai_propath_get, 0, 0, 1)
+	ZEND_ARG_INFO(0, root)
+ZEND_END_ARG_INFO();
+static PHP_METHOD(propath, get) {
+	zend_error_handling zeh;
+	zval *root;
+
+	zend_replace_error_handling(EH_THROW, NULL, &zeh);
+	if (SUCCESS == zend_parse_parameters(ZEND_NUM_ARGS(), "z", &root)) {
+		php_property_proxy_object_t *obj = get_propro(getThis());
+
+		if (obj->proxy) {
+			php_property_proxy_path_get(obj->proxy, root, return_value);
+			if (Z_ISUNDEF_P(return_value)) {
+				RETVAL_NULL();
+			}
+		} else {
+			php_error(E_WARNING, "Property path is not compiled");
+		}
+	}
+	zend_restore_error_handling(&zeh);
+}
+
+ZEND_BEGIN_ARG_INFO_EX(ai_propath_set, 0, 0, 2)
+	ZEND_ARG_INFO(1, root)
+	ZEND_ARG_INFO(0, value)
+ZEND_END_ARG_INFO();
+static PHP_METHOD(propath, set) {
+	zend_error_handling zeh;
+	zval *root, *value;
+
+	zend_replace_error_handling(EH_THROW, NULL, &zeh);
+	if (SUCCESS == zend_parse_parameters(ZEND_NUM_ARGS(), "zz", &root, &value)) {
+		php_property_proxy_object_t *obj = get_propro(getThis());
+
+		if (obj->proxy) {
+			php_property_proxy_path_set(obj->proxy, root, value);
+		} else {
+			php_error(E_WARNING, "Property path is not compiled");
+		}
+	}
+	zend_restore_error_handling(&zeh);
+}
+
+ZEND_BEGIN_ARG_INFO_EX(ai_propath_has, 0, 0, 1)
+	ZEND_ARG_INFO(0, root)
+ZEND_END_ARG_INFO();
+static PHP_METHOD(propath, has) {
+	zend_error_handling zeh;
+	zval *root;
+
+	zend_replace_error_handling(EH_THROW, NULL, &zeh);
+	if (SUCCESS == zend_parse_parameters(ZEND_NUM_ARGS(), "z", &root)) {
+		php_property_proxy_object_t *obj = get_propro(getThis());
+
+		if (obj->proxy) {
+			RETVAL_BOOL(php_property_proxy_path_has(obj->proxy, root));
+		} else {
+			php_error(E_WARNING, "Property path is not compiled");
+		}
+	}
+	zend_restore_error_handling(&zeh);
+}
+
+ZEND_BEGIN_ARG_INFO_EX(ai_propath_unset, 0, 0, 1)
+	ZEND_ARG_INFO(1, root)
+ZEND_END_ARG_INFO();
+static PHP_METHOD(propath, unset) {
+	zend_error_handling zeh;
+	zval *root;
+
+	zend_replace_error_handling(EH_THROW, NULL, &zeh);
+	if (SUCCESS == zend_parse_parameters(ZEND_NUM_ARGS(), "z", &root)) {
+		php_property_proxy_object_t *obj = get_propro(getThis());
+
+		if (obj->proxy) {
+			php_property_proxy_path_unset(obj->proxy, root);
+		} else {
+			php_error(E_WARNING, "Property path is not compiled");
+		}
+	}
+	zend_restore_error_handling(&zeh);
+}
+
+static const zend_function_entry php_property_path_method_entry[] = {
+	PHP_ME(propath, __construct, ai_propath_construct, ZEND_ACC_PUBLIC)
+	PHP_ME(propath, get, ai_propath_get, ZEND_ACC_PUBLIC)
+	PHP_ME(propath, set, ai_propath_set, ZEND_ACC_PUBLIC)
+	PHP_ME(propath, has, ai_propath_has, ZEND_ACC_PUBLIC)
+	PHP_ME(propath, unset, ai_propath_unset, ZEND_ACC_PUBLIC)
+	{0}
+};
+
+#if PHP_PROPRO_TEST
+/* see src/php_propro_test.c */
+extern PHP_MINIT_FUNCTION(propro_test);
+#endif
+
+static PHP_MINIT_FUNCTION(propro)
+{
+	zend_class_entry ce = {0};
+
+	INIT_NS_CLASS_ENTRY(ce, "php", "PropertyProxy",
+			php_property_proxy_method_entry);
+	php_property_proxy_class_entry = zend_register_internal_class(&ce);
+	php_property_proxy_class_entry->create_object =	php_property_proxy_object_new;
+	php_property_proxy_class_entry->ce_flags |= ZEND_ACC_FINAL;
+	php_property_proxy_class_entry->get_iterator = get_iterator;
+	php_property_proxy_class_entry->serialize = serialize_obj;
+	php_property_proxy_class_entry->unserialize = unserialize_obj;
+	zend_class_implements(php_property_proxy_class_entry, 2, zend_ce_traversable,
+			php_json_serializable_ce);
+
+	memcpy(&php_property_proxy_object_handlers, zend_get_std_object_handlers(),
+			sizeof(zend_object_handlers));
 	php_property_proxy_object_handlers.offset = XtOffsetOf(php_property_proxy_object_t, zo);
 	php_property_proxy_object_handlers.free_obj = destroy_obj;
 	php_property_proxy_object_handlers.get_gc = get_gc;
@@ -686,33 +3573,229 @@ static PHP_MINIT_FUNCTION(propro)
 	php_property_proxy_object_handlers.write_dimension = write_dimension;
 	php_property_proxy_object_handlers.has_dimension = has_dimension;
 	php_property_proxy_object_handlers.unset_dimension = unset_dimension;
+	php_property_proxy_object_handlers.count_elements = count_elements;
+	php_property_proxy_object_handlers.read_property = read_property;
+	php_property_proxy_object_handlers.write_property = write_property;
+	php_property_proxy_object_handlers.get_property_ptr_ptr = get_property_ptr_ptr;
+	php_property_proxy_object_handlers.has_property = has_property;
+	php_property_proxy_object_handlers.unset_property = unset_property;
+
+	memcpy(&php_property_proxy_storage_handlers, &php_property_proxy_object_handlers,
+			sizeof(zend_object_handlers));
+	php_property_proxy_storage_handlers.offset = XtOffsetOf(php_propro_object_ex_t, obj.zo);
+
+	memset(&ce, 0, sizeof(ce));
+	INIT_NS_CLASS_ENTRY(ce, "php", "PropertyPath",
+			php_property_path_method_entry);
+	php_property_path_class_entry = zend_register_internal_class(&ce);
+	php_property_path_class_entry->create_object = path_object_new;
+	php_property_path_class_entry->ce_flags |= ZEND_ACC_FINAL;
+
+	memcpy(&php_property_path_object_handlers, zend_get_std_object_handlers(),
+			sizeof(zend_object_handlers));
+	php_property_path_object_handlers.offset = XtOffsetOf(php_property_proxy_object_t, zo);
+	php_property_path_object_handlers.free_obj = destroy_obj;
+	php_property_path_object_handlers.clone_obj = NULL;
+	php_property_path_object_handlers.get_gc = get_gc;
+	php_property_path_object_handlers.get_debug_info = get_debug_info;
+
+#if PHP_PROPRO_TEST
+	if (SUCCESS != PHP_MINIT(propro_test)(INIT_FUNC_ARGS_PASSTHRU)) {
+		return FAILURE;
+	}
+#endif
+
+	return SUCCESS;
+}
+
+static PHP_GINIT_FUNCTION(propro)
+{
+#if defined(ZTS) && defined(COMPILE_DL_PROPRO)
+	ZEND_TSRMLS_CACHE_UPDATE();
+#endif
+	memset(propro_globals, 0, sizeof(*propro_globals));
+}
+
+static PHP_RINIT_FUNCTION(propro)
+{
+	memset(&PROPRO_G(stats), 0, sizeof(PROPRO_G(stats)));
+
+	return SUCCESS;
+}
+
+/*
+ * Deferred writes have been committed by the shutdown function, or when
+ * their proxies have been destroyed; writes buffered later than that, e.g.
+ * by destructors, are dropped silently, since user code, including error
+ * handlers, must not run anymore.
+ * The cached member names might be interned strings of the request.
+ */
+static PHP_RSHUTDOWN_FUNCTION(propro)
+{
+	int n;
+
+	if (PROPRO_G(deferred)) {
+		while (zend_hash_num_elements(PROPRO_G(deferred))) {
+			zval *entry;
+
+			zend_hash_internal_pointer_reset(PROPRO_G(deferred));
+			entry = zend_hash_get_current_data(PROPRO_G(deferred));
+			end_deferred(Z_PTR_P(entry), 0);
+		}
+		zend_hash_destroy(PROPRO_G(deferred));
+		FREE_HASHTABLE(PROPRO_G(deferred));
+		PROPRO_G(deferred) = NULL;
+	}
+	PROPRO_G(committing) = 0;
+	for (n = 0; n < PROPRO_GENERATIONS; ++n) {
+		if (PROPRO_G(caching)[n]) {
+			zend_hash_destroy(PROPRO_G(caching)[n]);
+			FREE_HASHTABLE(PROPRO_G(caching)[n]);
+			PROPRO_G(caching)[n] = NULL;
+		}
+		PROPRO_G(cached)[n] = 0;
+	}
+	if (PROPRO_G(journals)) {
+		/* releasing a container might write through a property proxy */
+		zend_hash_graceful_reverse_destroy(PROPRO_G(journals));
+		FREE_HASHTABLE(PROPRO_G(journals));
+		PROPRO_G(journals) = NULL;
+	}
+
+	for (n = 0; n < PROPRO_CACHE_SIZE; ++n) {
+		if (PROPRO_G(cache)[n].name) {
+			zend_string_release(PROPRO_G(cache)[n].name);
+		}
+	}
+	memset(PROPRO_G(cache), 0, sizeof(PROPRO_G(cache)));
+
+	return SUCCESS;
+}
+
+/*
+ * Proxies are still being freed while the executor shuts down, so the free
+ * lists are drained after that, but before the memory manager shuts down.
+ */
+static ZEND_MODULE_POST_ZEND_DEACTIVATE_D(propro)
+{
+	int n;
+
+	pool_drain(&PROPRO_G(proxies));
+	for (n = 0; n < PROPRO_PATH_POOLS; ++n) {
+		pool_drain(&PROPRO_G(paths)[n]);
+	}
 
 	return SUCCESS;
 }
 
+static void print_stat(const char *name, zend_ulong value)
+{
+	char buf[MAX_LENGTH_OF_LONG + 1];
+
+	snprintf(buf, sizeof(buf), ZEND_ULONG_FMT, value);
+	php_info_print_table_row(2, name, buf);
+}
+
 PHP_MINFO_FUNCTION(propro)
 {
+	php_propro_stats_t *stats = &PROPRO_G(stats);
+	char name[32];
+	int n;
+
 	php_info_print_table_start();
 	php_info_print_table_header(2, "Property proxy support", "enabled");
 	php_info_print_table_row(2, "Extension version", PHP_PROPRO_VERSION);
 	php_info_print_table_end();
+
+	php_info_print_table_start();
+	php_info_print_table_header(2, "Request statistics", "Count");
+	print_stat("Proxies created", stats->proxies_created);
+	print_stat("Proxies freed", stats->proxies_freed);
+	print_stat("Allocations", stats->allocations);
+	print_stat("Array separations", stats->separations);
+	print_stat("Array bytes separated", stats->separated_bytes);
+	print_stat("Property write-backs", stats->writebacks);
+	print_stat("Key conversions", stats->key_conversions);
+	for (n = 0; n < PROPRO_STATS_DEPTHS; ++n) {
+		snprintf(name, sizeof(name), "Proxies of path depth %d%s", n + 1,
+				n + 1 < PROPRO_STATS_DEPTHS ? "" : "+");
+		print_stat(name, stats->depths[n]);
+	}
+	php_info_print_table_end();
+}
+
+ZEND_BEGIN_ARG_INFO_EX(ai_propro_commit_all, 0, 0, 0)
+ZEND_END_ARG_INFO();
+/*
+ * Commit the buffers of all deferring property proxies of the request.
+ */
+static PHP_FUNCTION(propro_commit_all)
+{
+	if (SUCCESS == zend_parse_parameters_none()) {
+		commit_deferred();
+	}
+}
+
+ZEND_BEGIN_ARG_INFO_EX(ai_propro_stats, 0, 0, 0)
+ZEND_END_ARG_INFO();
+/*
+ * Get the counters of the current request; the depths are indexed by path
+ * depth, the last one counts deeper paths, too.
+ */
+static PHP_FUNCTION(propro_stats)
+{
+	php_propro_stats_t *stats = &PROPRO_G(stats);
+	zval depths;
+	int n;
+
+	if (SUCCESS != zend_parse_parameters_none()) {
+		return;
+	}
+
+	array_init(return_value);
+	add_assoc_long(return_value, "proxies_created", stats->proxies_created);
+	add_assoc_long(return_value, "proxies_freed", stats->proxies_freed);
+	add_assoc_long(return_value, "allocations", stats->allocations);
+	add_assoc_long(return_value, "separations", stats->separations);
+	add_assoc_long(return_value, "separated_bytes", stats->separated_bytes);
+	add_assoc_long(return_value, "writebacks", stats->writebacks);
+	add_assoc_long(return_value, "key_conversions", stats->key_conversions);
+
+	array_init_size(&depths, PROPRO_STATS_DEPTHS);
+	for (n = 0; n < PROPRO_STATS_DEPTHS; ++n) {
+		add_index_long(&depths, n + 1, stats->depths[n]);
+	}
+	add_assoc_zval(return_value, "depths", &depths);
 }
 
 static const zend_function_entry propro_functions[] = {
+	ZEND_NS_FE("php", propro_commit_all, ai_propro_commit_all)
+	ZEND_NS_FE("php", propro_stats, ai_propro_stats)
 	{0}
 };
 
+static const zend_module_dep propro_deps[] = {
+	ZEND_MOD_REQUIRED("json")
+	ZEND_MOD_END
+};
+
 zend_module_entry propro_module_entry = {
-	STANDARD_MODULE_HEADER,
+	STANDARD_MODULE_HEADER_EX,
+	NULL,
+	propro_deps,
 	"propro",
 	propro_functions,
 	PHP_MINIT(propro),
 	NULL,
-	NULL,
-	NULL,
+	PHP_RINIT(propro),
+	PHP_RSHUTDOWN(propro),
 	PHP_MINFO(propro),
 	PHP_PROPRO_VERSION,
-	STANDARD_MODULE_PROPERTIES
+	PHP_MODULE_GLOBALS(propro),
+	PHP_GINIT(propro),
+	NULL,
+	ZEND_MODULE_POST_ZEND_DEACTIVATE_N(propro),
+	STANDARD_MODULE_PROPERTIES_EX
 };
 
 #ifdef COMPILE_DL_PROPRO
@@ -15,16 +15,79 @@
 
 #include "php_propro.h"
 
+#include <zend_smart_str.h>
+
+/**
+ * The number of keys a property proxy stores inline.
+ */
+#define PHP_PROPRO_PATH_INLINE 4
+
+/**
+ * The state of a property proxy in deferred write-back mode.
+ */
+typedef struct php_property_proxy_deferred php_property_proxy_deferred_t;
+
+/**
+ * The accessors of a native property.
+ *
+ * A property proxy created by php_property_proxy_init_ops() reads and
+ * writes its property through these, instead of the property handlers of
+ * its container. Each accessor gets the opaque pointer to the native
+ * storage and the integer or string key of the property.
+ */
+typedef struct php_property_proxy_ops {
+	/** Read the property into \a return_value, which the caller releases */
+	void (*get)(void *data, zval *member, zval *return_value);
+	/** Write \a value to the property */
+	void (*set)(void *data, zval *member, zval *value);
+	/** Check whether \a key of the property is set; optional */
+	int (*has)(void *data, zval *member, zval *key, int check_empty);
+	/** Unset \a key of the property; optional */
+	void (*unset)(void *data, zval *member, zval *key);
+	/** Count the elements of the property; optional */
+	int (*count)(void *data, zval *member, zend_long *count);
+	/** Create an iterator over the property for \a object; optional */
+	zend_object_iterator *(*iterate)(void *data, zval *member, zval *object,
+			int by_ref);
+} php_property_proxy_ops_t;
+
 /**
  * The internal property proxy.
  *
  * Container for the object/array holding the proxied property.
+ *
+ * Since 3.0.0, a proxy of a nested member has no parent proxy, but the path
+ * of keys from the root container, and member is NULL for integer keys.
  */
 struct php_property_proxy {
 	/** The reference to the container holding the property */
 	zval container;
-	/** The name of the proxied property */
+	/** The cached value of the proxied property in caching mode, else UNDEF */
+	zval cached;
+	/** The name of the proxied property, NULL for integer keys */
 	zend_string *member;
+	/** The integer or string keys leading from container to the proxied property */
+	zval *path;
+	/** The accessors of a native property, else NULL */
+	const php_property_proxy_ops_t *ops;
+	/** The opaque pointer to the native storage passed to ops */
+	void *data;
+	/** The buffered writes in deferred write-back mode, else NULL */
+	php_property_proxy_deferred_t *deferred;
+	/** The interned child proxy objects keyed by member, or NULL */
+	HashTable *children;
+	/** The WeakReference to the borrowed container in weak mode, else NULL */
+	zend_object *weakref;
+	/** The generation of the container the cached value was resolved at */
+	zend_ulong generation;
+	/** The number of keys in path, including the proxied property's one */
+	uint32_t depth;
+	/** Whether the resolved value of the proxied property is cached */
+	zend_bool caching;
+	/** Whether objects of this and child proxies bypass the cycle collector */
+	zend_bool untracked;
+	/** The storage of path, if it does not exceed PHP_PROPRO_PATH_INLINE keys */
+	zval path_inline[PHP_PROPRO_PATH_INLINE];
 };
 typedef struct php_property_proxy php_property_proxy_t;
 
@@ -68,13 +131,22 @@ typedef struct php_property_proxy php_property_proxy_t;
 struct php_property_proxy_object {
 	/** The actual property proxy */
 	php_property_proxy_t *proxy;
-	/** Any parent property proxy object */
-	zval parent;
+	/** The buffer of the zvals reported to the garbage collector */
+	zval gc[2];
 	/** The std zend_object */
 	zend_object zo;
 };
 typedef struct php_property_proxy_object php_property_proxy_object_t;
 
+/**
+ * Get the php_property_proxy_object_t of a php\PropertyProxy zend_object
+ *
+ * Objects created along with their property proxy carry its storage in
+ * front of them, so PHP_PROPRO_PTR() does not apply to them.
+ */
+#define PHP_PROPRO_OBJECT(o) ((php_property_proxy_object_t *) \
+		((char *) (o) - XtOffsetOf(php_property_proxy_object_t, zo)))
+
 /**
  * Create a property proxy
  *
@@ -88,6 +160,38 @@ typedef struct php_property_proxy_object php_property_proxy_object_t;
 PHP_PROPRO_API php_property_proxy_t *php_property_proxy_init(zval *container,
 		zend_string *member);
 
+/**
+ * Create a property proxy of a native property
+ *
+ * The property proxy will read and write the property with name \a member
+ * through \a ops, which are passed \a data, instead of going through the
+ * property handlers of \a container. Child proxies share \a ops and
+ * \a data, so \a data has to live as long as \a container, which the
+ * property proxy holds on to.
+ *
+ * @param container the object owning the native storage
+ * @param member the name of the proxied property
+ * @param ops the accessors of the native property
+ * @param data the opaque pointer to the native storage
+ * @return a new property proxy
+ */
+PHP_PROPRO_API php_property_proxy_t *php_property_proxy_init_ops(zval *container,
+		zend_string *member, const php_property_proxy_ops_t *ops, void *data);
+
+/**
+ * Create a property proxy for a member of a proxied property
+ *
+ * The new property proxy shares the root container of \a parent and
+ * proxies the property with name \a member of the property proxied by
+ * \a parent, which is resolved in a single pass on access.
+ *
+ * @param parent the property proxy of the property holding \a member
+ * @param member the integer or string key of the proxied property
+ * @return a new property proxy
+ */
+PHP_PROPRO_API php_property_proxy_t *php_property_proxy_init_child(
+		php_property_proxy_t *parent, zval *member);
+
 /**
  * Destroy and free a property proxy.
  *
@@ -97,6 +201,239 @@ PHP_PROPRO_API php_property_proxy_t *php_property_proxy_init(zval *container,
  */
 PHP_PROPRO_API void php_property_proxy_free(php_property_proxy_t **proxy);
 
+/**
+ * Write and unset several members of the proxied property at once
+ *
+ * The path to the proxied property is resolved and separated once, and
+ * containers without property slots are written back once, after all
+ * changes have been applied.
+ *
+ * @param proxy the property proxy
+ * @param values the members to write keyed by their names, or NULL
+ * @param keys the names of the members to unset, or NULL
+ */
+PHP_PROPRO_API void php_property_proxy_write_many(php_property_proxy_t *proxy,
+		HashTable *values, HashTable *keys);
+
+/**
+ * Make room for more elements in the proxied property
+ *
+ * A missing or scalar property is converted to an array first, like it
+ * would be by a write through \a proxy. The array is then extended at once
+ * to hold \a n more elements, so a bulk fill of known size does not
+ * rehash as it grows.
+ *
+ * @param proxy the property proxy
+ * @param n the number of elements to make room for
+ * @param packed whether to keep or make the array a packed list; a hash
+ * stays a hash
+ */
+PHP_PROPRO_API void php_property_proxy_reserve(php_property_proxy_t *proxy,
+		uint32_t n, zend_bool packed);
+
+/**
+ * Defer the writes through a property proxy
+ *
+ * Writes through \a proxy and its child proxies are buffered, and reads
+ * through them see the buffered value. The buffer is written back to the
+ * proxied property by php_property_proxy_commit(), when \a proxy is
+ * destroyed, or by a shutdown function, which runs before the destructors
+ * of the request, like php\propro_commit_all() does. Writes buffered after
+ * that, which are not committed before the end of the request, are dropped
+ * silently.
+ *
+ * @param proxy the property proxy
+ */
+PHP_PROPRO_API void php_property_proxy_defer(php_property_proxy_t *proxy);
+
+/**
+ * Write back the buffered value of a deferring property proxy
+ *
+ * Nothing is written, if the buffered value did not change since it has
+ * been read or written back last.
+ *
+ * @param proxy the property proxy
+ */
+PHP_PROPRO_API void php_property_proxy_commit(php_property_proxy_t *proxy);
+
+/**
+ * Cache the resolved value of the proxied property
+ *
+ * Reads through \a proxy resolve the path to the proxied property only
+ * once, until a write through any property proxy sharing the root container
+ * of \a proxy, or php_property_proxy_invalidate(), invalidates the cached
+ * value. Writes to the root container bypassing property proxies are not
+ * noticed.
+ *
+ * @param proxy the property proxy
+ * @param enable whether to enable or disable caching
+ */
+PHP_PROPRO_API void php_property_proxy_cache(php_property_proxy_t *proxy,
+		zend_bool enable);
+
+/**
+ * Invalidate the cached values of property proxies of a container
+ *
+ * Owners of native storage call this after changing it without going
+ * through a property proxy.
+ *
+ * @param container the root container of the property proxies
+ */
+PHP_PROPRO_API void php_property_proxy_invalidate(zval *container);
+
+/**
+ * Start or stop journaling the changes of a root container
+ *
+ * Writes and unsets through property proxies of \a container record the
+ * paths of the changed members, so that owners of native storage can sync
+ * only what changed. A recorded path implies the changes below it. The
+ * journal holds on to \a container until it is stopped or the request
+ * ends.
+ *
+ * @param container the root container of the property proxies
+ * @param enable whether to start or stop journaling
+ */
+PHP_PROPRO_API void php_property_proxy_journal(zval *container, zend_bool enable);
+
+/**
+ * Get the journaled changes of a root container
+ *
+ * @param container the root container of the property proxies
+ * @return the changed paths as arrays of integer or string keys, or NULL if
+ * the changes of \a container are not journaled
+ */
+PHP_PROPRO_API HashTable *php_property_proxy_changes(zval *container);
+
+/**
+ * Clear the journaled changes of a root container
+ *
+ * @param container the root container of the property proxies
+ */
+PHP_PROPRO_API void php_property_proxy_clear_changes(zval *container);
+
+/**
+ * Keep the objects of a property proxy out of the cycle collector
+ *
+ * Objects instantiated for \a proxy or its child proxies afterwards are
+ * never buffered as possible roots of garbage cycles, so proxies in a cycle
+ * are only freed at the end of the request. This takes effect as of
+ * PHP 7.3.
+ *
+ * @param proxy the property proxy
+ * @param enable whether to keep the objects out of the cycle collector
+ */
+PHP_PROPRO_API void php_property_proxy_untrack(php_property_proxy_t *proxy,
+		zend_bool enable);
+
+/**
+ * Hold the container of a property proxy through a WeakReference
+ *
+ * The property proxy and its child proxies do not keep their container
+ * alive anymore; once it has been freed, they proxy a property of NULL.
+ * This requires PHP 7.4, an object container and no native accessors.
+ *
+ * @param proxy the property proxy
+ * @return SUCCESS, or FAILURE if the container cannot be weakly referenced
+ */
+PHP_PROPRO_API ZEND_RESULT_CODE php_property_proxy_weaken(php_property_proxy_t *proxy);
+
+/**
+ * Compile a property path
+ *
+ * The path consists of names separated by dots and of keys in brackets,
+ * like a.b[3].c; numeric names and keys become integer keys. The compiled
+ * path is a property proxy without container, which can be applied to any
+ * root container with the php_property_proxy_path_*() functions.
+ *
+ * @param path the property path
+ * @param len the length of \a path
+ * @return a new property proxy, or NULL if \a path is invalid
+ */
+PHP_PROPRO_API php_property_proxy_t *php_property_proxy_compile(const char *path,
+		size_t len);
+
+/**
+ * Read the property at a compiled path of a root container
+ *
+ * @param path the compiled path
+ * @param root the root array or object
+ * @param return_value the value owned by the caller, UNDEF if not found
+ * @return \a return_value
+ */
+PHP_PROPRO_API zval *php_property_proxy_path_get(php_property_proxy_t *path,
+		zval *root, zval *return_value);
+
+/**
+ * Write the property at a compiled path of a root container
+ *
+ * Missing intermediate members are created as arrays in the same pass.
+ *
+ * @param path the compiled path
+ * @param root the root object, or a reference to the root array
+ * @param value the value to write
+ */
+PHP_PROPRO_API void php_property_proxy_path_set(php_property_proxy_t *path,
+		zval *root, zval *value);
+
+/**
+ * Check whether the property at a compiled path of a root container is set
+ *
+ * @param path the compiled path
+ * @param root the root array or object
+ * @return whether the property exists and is not NULL
+ */
+PHP_PROPRO_API int php_property_proxy_path_has(php_property_proxy_t *path,
+		zval *root);
+
+/**
+ * Unset the property at a compiled path of a root container
+ *
+ * @param path the compiled path
+ * @param root the root object, or a reference to the root array
+ */
+PHP_PROPRO_API void php_property_proxy_path_unset(php_property_proxy_t *path,
+		zval *root);
+
+/**
+ * Read the property at a compiled path of many root containers
+ *
+ * The property handlers of object rows are called with the run-time cache
+ * slots of their class, like for single property proxies.
+ *
+ * @param path the compiled path
+ * @param containers an array or Traversable of root arrays and objects
+ * @param return_value a packed array of the values, NULL if not found
+ */
+PHP_PROPRO_API void php_property_proxy_gather(php_property_proxy_t *path,
+		zval *containers, zval *return_value);
+
+/**
+ * Write the property at a compiled path of many root containers
+ *
+ * The values are paired with the rows by position; rows without a value
+ * are left alone. Array rows are written in place.
+ *
+ * @param path the compiled path
+ * @param containers the writable table of root arrays and objects
+ * @param values the values to write
+ */
+PHP_PROPRO_API void php_property_proxy_scatter(php_property_proxy_t *path,
+		HashTable *containers, HashTable *values);
+
+/**
+ * Encode the proxied property as JSON
+ *
+ * The value is encoded straight from its container into \a buf, without
+ * separating it first.
+ *
+ * @param proxy the property proxy
+ * @param buf the buffer to append to
+ * @param options the json_encode() options
+ * @return SUCCESS, or FAILURE with the error set like by json_encode()
+ */
+PHP_PROPRO_API ZEND_RESULT_CODE php_property_proxy_json_encode(
+		php_property_proxy_t *proxy, smart_str *buf, int options);
+
 /**
  * Get the zend_class_entry of php\\PropertyProxy
  * @return the class entry pointer
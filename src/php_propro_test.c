@@ -0,0 +1,260 @@
+/*
+    +--------------------------------------------------------------------+
+    | PECL :: propro                                                     |
+    +--------------------------------------------------------------------+
+    | Redistribution and use in source and binary forms, with or without |
+    | modification, are permitted provided that the conditions mentioned |
+    | in the accompanying LICENSE file are met.                          |
+    +--------------------------------------------------------------------+
+    | Copyright (c) 2013 Michael Wallner <mike@php.net>                  |
+    +--------------------------------------------------------------------+
+*/
+
+
+#ifdef HAVE_CONFIG_H
+#	include "config.h"
+#endif
+
+#include <php.h>
+
+#include "php_propro_api.h"
+
+/*
+ * php\PropertyProxyTest keeps its properties in a native array, which the
+ * proxies it hands out access through php_property_proxy_ops_t only, and
+ * logs the calls of the ops. This file is only built with
+ * --enable-propro-test.
+ */
+typedef struct php_propro_test_object {
+	zval props;
+	zval calls;
+	zend_object zo;
+} php_propro_test_object_t;
+
+static zend_class_entry *php_propro_test_class_entry;
+static zend_object_handlers php_propro_test_object_handlers;
+
+static inline php_propro_test_object_t *get_propro_test(zval *object)
+{
+	return PHP_PROPRO_PTR(Z_OBJ_P(object));
+}
+
+/* keys handed to the ops are either integers or strings */
+static inline zval *test_find(zval *array, zval *key)
+{
+	if (Z_TYPE_P(key) == IS_LONG) {
+		return zend_hash_index_find(Z_ARRVAL_P(array), Z_LVAL_P(key));
+	}
+	return zend_hash_find(Z_ARRVAL_P(array), Z_STR_P(key));
+}
+
+static void test_log(php_propro_test_object_t *t, const char *op, zval *member,
+		zval *key)
+{
+	zend_string *name = zval_get_string(member);
+
+	if (key) {
+		zend_string *str = zval_get_string(key);
+
+		add_next_index_str(&t->calls, strpprintf(0, "%s(%s, %s)", op,
+				name->val, str->val));
+		zend_string_release(str);
+	} else {
+		add_next_index_str(&t->calls, strpprintf(0, "%s(%s)", op, name->val));
+	}
+	zend_string_release(name);
+}
+
+static void test_get(void *data, zval *member, zval *return_value)
+{
+	php_propro_test_object_t *t = data;
+	zval *value = test_find(&t->props, member);
+
+	test_log(t, "get", member, NULL);
+	if (value) {
+		ZVAL_COPY(return_value, value);
+	} else {
+		ZVAL_NULL(return_value);
+	}
+}
+
+static void test_set(void *data, zval *member, zval *value)
+{
+	php_propro_test_object_t *t = data;
+
+	test_log(t, "set", member, NULL);
+	SEPARATE_ARRAY(&t->props);
+	Z_TRY_ADDREF_P(value);
+	if (Z_TYPE_P(member) == IS_LONG) {
+		zend_hash_index_update(Z_ARRVAL(t->props), Z_LVAL_P(member), value);
+	} else {
+		zend_hash_update(Z_ARRVAL(t->props), Z_STR_P(member), value);
+	}
+}
+
+static int test_has(void *data, zval *member, zval *key, int check_empty)
+{
+	php_propro_test_object_t *t = data;
+	zval *value = test_find(&t->props, member);
+
+	test_log(t, "has", member, key);
+	if (!value || Z_TYPE_P(value) != IS_ARRAY
+			|| !(value = test_find(value, key))) {
+		return 0;
+	}
+	return check_empty ? zend_is_true(value) : Z_TYPE_P(value) != IS_NULL;
+}
+
+static void test_unset(void *data, zval *member, zval *key)
+{
+	php_propro_test_object_t *t = data;
+	zval *value;
+
+	test_log(t, "unset", member, key);
+	SEPARATE_ARRAY(&t->props);
+	if ((value = test_find(&t->props, member)) && Z_TYPE_P(value) == IS_ARRAY) {
+		SEPARATE_ARRAY(value);
+		if (Z_TYPE_P(key) == IS_LONG) {
+			zend_hash_index_del(Z_ARRVAL_P(value), Z_LVAL_P(key));
+		} else {
+			zend_hash_del(Z_ARRVAL_P(value), Z_STR_P(key));
+		}
+	}
+}
+
+static int test_count(void *data, zval *member, zend_long *count)
+{
+	php_propro_test_object_t *t = data;
+	zval *value = test_find(&t->props, member);
+
+	test_log(t, "count", member, NULL);
+	if (!value || Z_TYPE_P(value) != IS_ARRAY) {
+		return FAILURE;
+	}
+	*count = zend_hash_num_elements(Z_ARRVAL_P(value));
+	return SUCCESS;
+}
+
+/* without iterate, to also cover the generic iteration of native values */
+static const php_property_proxy_ops_t php_propro_test_ops = {
+	test_get,
+	test_set,
+	test_has,
+	test_unset,
+	test_count,
+	NULL
+};
+
+static zend_object *test_object_new(zend_class_entry *ce)
+{
+	php_propro_test_object_t *t;
+
+	t = ecalloc(1, sizeof(*t) + zend_object_properties_size(ce));
+	zend_object_std_init(&t->zo, ce);
+	object_properties_init(&t->zo, ce);
+	array_init(&t->props);
+	array_init(&t->calls);
+	t->zo.handlers = &php_propro_test_object_handlers;
+
+	return &t->zo;
+}
+
+static void test_object_free(zend_object *object)
+{
+	php_propro_test_object_t *t = PHP_PROPRO_PTR(object);
+
+	zval_ptr_dtor(&t->props);
+	zval_ptr_dtor(&t->calls);
+	zend_object_std_dtor(object);
+}
+
+ZEND_BEGIN_ARG_INFO_EX(ai_proprotest_construct, 0, 0, 0)
+	ZEND_ARG_ARRAY_INFO(0, props, 0)
+ZEND_END_ARG_INFO();
+static PHP_METHOD(proprotest, __construct) {
+	zend_error_handling zeh;
+	zval *props = NULL;
+
+	zend_replace_error_handling(EH_THROW, NULL, &zeh);
+	if (SUCCESS == zend_parse_parameters(ZEND_NUM_ARGS(), "|a", &props)) {
+		php_propro_test_object_t *t = get_propro_test(getThis());
+
+		if (props) {
+			zval_ptr_dtor(&t->props);
+			ZVAL_COPY(&t->props, props);
+		}
+	}
+	zend_restore_error_handling(&zeh);
+}
+
+ZEND_BEGIN_ARG_INFO_EX(ai_proprotest_proxy, 0, 0, 1)
+	ZEND_ARG_INFO(0, member)
+ZEND_END_ARG_INFO();
+static PHP_METHOD(proprotest, proxy) {
+	zend_string *member;
+
+	if (SUCCESS == zend_parse_parameters(ZEND_NUM_ARGS(), "S", &member)) {
+		php_property_proxy_t *proxy = php_property_proxy_init_ops(getThis(),
+				member, &php_propro_test_ops, get_propro_test(getThis()));
+
+		RETVAL_OBJ(&php_property_proxy_object_new_ex(NULL, proxy)->zo);
+	}
+}
+
+ZEND_BEGIN_ARG_INFO_EX(ai_proprotest_calls, 0, 0, 0)
+ZEND_END_ARG_INFO();
+static PHP_METHOD(proprotest, calls) {
+	if (SUCCESS == zend_parse_parameters_none()) {
+		php_propro_test_object_t *t = get_propro_test(getThis());
+
+		ZVAL_COPY_VALUE(return_value, &t->calls);
+		array_init(&t->calls);
+	}
+}
+
+ZEND_BEGIN_ARG_INFO_EX(ai_proprotest_toArray, 0, 0, 0)
+ZEND_END_ARG_INFO();
+static PHP_METHOD(proprotest, toArray) {
+	if (SUCCESS == zend_parse_parameters_none()) {
+		RETVAL_ZVAL(&get_propro_test(getThis())->props, 1, 0);
+	}
+}
+
+static const zend_function_entry php_propro_test_method_entry[] = {
+	PHP_ME(proprotest, __construct, ai_proprotest_construct, ZEND_ACC_PUBLIC)
+	PHP_ME(proprotest, proxy, ai_proprotest_proxy, ZEND_ACC_PUBLIC)
+	PHP_ME(proprotest, calls, ai_proprotest_calls, ZEND_ACC_PUBLIC)
+	PHP_ME(proprotest, toArray, ai_proprotest_toArray, ZEND_ACC_PUBLIC)
+	{0}
+};
+
+/*
+ * Called by the MINIT of propro when built with --enable-propro-test.
+ */
+PHP_MINIT_FUNCTION(propro_test)
+{
+	zend_class_entry ce = {0};
+
+	INIT_NS_CLASS_ENTRY(ce, "php", "PropertyProxyTest",
+			php_propro_test_method_entry);
+	php_propro_test_class_entry = zend_register_internal_class(&ce);
+	php_propro_test_class_entry->create_object = test_object_new;
+	php_propro_test_class_entry->ce_flags |= ZEND_ACC_FINAL;
+
+	memcpy(&php_propro_test_object_handlers, zend_get_std_object_handlers(),
+			sizeof(zend_object_handlers));
+	php_propro_test_object_handlers.offset = XtOffsetOf(php_propro_test_object_t, zo);
+	php_propro_test_object_handlers.free_obj = test_object_free;
+	php_propro_test_object_handlers.clone_obj = NULL;
+
+	return SUCCESS;
+}
+
+/*
+ * Local variables:
+ * tab-width: 4
+ * c-basic-offset: 4
+ * End:
+ * vim600: noet sw=4 ts=4 fdm=marker
+ * vim<600: noet sw=4 ts=4
+ */
@@ -0,0 +1,76 @@
+--TEST--
+property proxy copy on write
+--SKIPIF--
+<?php
+extension_loaded("propro") || print "skip";
+?>
+--FILE--
+<?php
+echo "Test\n";
+
+class c {
+	private $data;
+	function __construct($n) {
+		$this->data = range(1, $n);
+		$this->data["sub"] = [];
+		/* own the sub array, the empty literal is shared */
+		$this->data["sub"]["x"] = 0;
+	}
+	function __get($p) {
+		return new php\PropertyProxy($this, $p);
+	}
+	function get() {
+		return $this->data;
+	}
+	function &ref() {
+		return $this->data;
+	}
+}
+
+function run($n) {
+	$c = new c($n);
+	$p = $c->data;
+	$stats = php\propro_stats();
+	for ($i = 0; $i < 1000; ++$i) {
+		$p[$i] = -$i;
+		$p["sub"]["x"] = $i;
+	}
+	$after = php\propro_stats();
+
+	$a = $c->get();
+	if ($a[999] !== -999 || $a["sub"]["x"] !== 999 || count($a) !== $n + 1) {
+		echo "unexpected values\n";
+	}
+	/* writes to an array owned by the object must not copy it */
+	printf("%6d separations: %d bytes: %d\n", $n,
+			$after["separations"] - $stats["separations"],
+			$after["separated_bytes"] - $stats["separated_bytes"]);
+}
+
+run(1000);
+run(100000);
+
+// shared arrays must still be separated
+$c = new c(3);
+$copy = $c->get();
+$p1 = $c->data;
+$p1[0] = "changed";
+var_dump($copy[0], $c->get()[0]);
+
+// writes through references must reach all holders
+$c = new c(3);
+$r = &$c->ref();
+$p2 = $c->data;
+$p2[1] = "ref";
+var_dump($r[1]);
+
+?>
+===DONE===
+--EXPECT--
+Test
+  1000 separations: 0 bytes: 0
+100000 separations: 0 bytes: 0
+int(1)
+string(7) "changed"
+string(3) "ref"
+===DONE===
@@ -0,0 +1,71 @@
+--TEST--
+property proxy deep parent chain
+--SKIPIF--
+<?php
+extension_loaded("propro") || print "skip";
+?>
+--FILE--
+<?php
+echo "Test\n";
+
+class c {
+	private $tree;
+	function __get($p) {
+		return new php\PropertyProxy($this, $p);
+	}
+}
+
+$c = new c;
+$chain = [$c->tree];
+foreach (["a", "b", "c", "d", "e", "f", "g"] as $i => $k) {
+	$chain[$i+1] = new php\PropertyProxy(null, $k, $chain[$i]);
+}
+$leaf = $chain[7];
+unset($chain);
+
+$leaf["x"] = 1;
+$leaf["y"][] = 2;
+var_dump($leaf["x"], isset($leaf["y"]), isset($leaf["z"]));
+var_dump($c);
+
+?>
+===DONE===
+--EXPECTF--
+Test
+int(1)
+bool(true)
+bool(false)
+object(c)#%d (1) {
+  ["tree":"c":private]=>
+  array(1) {
+    ["a"]=>
+    array(1) {
+      ["b"]=>
+      array(1) {
+        ["c"]=>
+        array(1) {
+          ["d"]=>
+          array(1) {
+            ["e"]=>
+            array(1) {
+              ["f"]=>
+              array(1) {
+                ["g"]=>
+                array(2) {
+                  ["x"]=>
+                  int(1)
+                  ["y"]=>
+                  array(1) {
+                    [0]=>
+                    int(2)
+                  }
+                }
+              }
+            }
+          }
+        }
+      }
+    }
+  }
+}
+===DONE===
@@ -0,0 +1,79 @@
+--TEST--
+property proxy write back to magic properties
+--SKIPIF--
+<?php
+extension_loaded("propro") || print "skip";
+?>
+--FILE--
+<?php
+echo "Test\n";
+
+class c {
+	public $sets = 0;
+	private $real = [];
+	private $virt = [];
+	function __get($p) {
+		return $this->virt[$p] ?? null;
+	}
+	function __set($p, $v) {
+		++$this->sets;
+		$this->virt[$p] = $v;
+	}
+	function proxy($p) {
+		return new php\PropertyProxy($this, $p);
+	}
+}
+
+$c = new c;
+
+$r = $c->proxy("real");
+$r["a"]["b"]["c"] = 1;
+$r["a"]["b"]["d"] = 2;
+var_dump($c->sets);
+
+$v = $c->proxy("magic");
+$v["a"]["b"]["c"] = 1;
+$v["a"]["b"]["d"] = 2;
+var_dump($c->sets);
+
+var_dump($c);
+?>
+===DONE===
+--EXPECTF--
+Test
+int(0)
+int(2)
+object(c)#%d (3) {
+  ["sets"]=>
+  int(2)
+  ["real":"c":private]=>
+  array(1) {
+    ["a"]=>
+    array(1) {
+      ["b"]=>
+      array(2) {
+        ["c"]=>
+        int(1)
+        ["d"]=>
+        int(2)
+      }
+    }
+  }
+  ["virt":"c":private]=>
+  array(1) {
+    ["magic"]=>
+    array(1) {
+      ["a"]=>
+      array(1) {
+        ["b"]=>
+        array(2) {
+          ["c"]=>
+          int(1)
+          ["d"]=>
+          int(2)
+        }
+      }
+    }
+  }
+}
+===DONE===
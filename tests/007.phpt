@@ -0,0 +1,61 @@
+--TEST--
+property proxy integer offsets
+--SKIPIF--
+<?php
+extension_loaded("propro") || print "skip";
+?>
+--FILE--
+<?php
+echo "Test\n";
+
+class c {
+	private $list = [];
+	function __get($p) {
+		return new php\PropertyProxy($this, $p);
+	}
+}
+
+$c = new c;
+$l = $c->list;
+
+for ($i = 0; $i < 3; ++$i) {
+	$l[] = $i;
+}
+$l[1] = "one";
+$l["2"] = "two";
+$l["02"] = "zero-two";
+$l[-1] = "minus";
+$l[3][] = "nested";
+
+var_dump(isset($l[1]), isset($l["1"]), isset($l[5]), $l["0"], $l[2]);
+unset($l["1"]);
+var_dump($c);
+
+?>
+===DONE===
+--EXPECTF--
+Test
+bool(true)
+bool(true)
+bool(false)
+int(0)
+string(3) "two"
+object(c)#%d (1) {
+  ["list":"c":private]=>
+  array(5) {
+    [0]=>
+    int(0)
+    [2]=>
+    string(3) "two"
+    ["02"]=>
+    string(8) "zero-two"
+    [-1]=>
+    string(5) "minus"
+    [3]=>
+    array(1) {
+      [0]=>
+      string(6) "nested"
+    }
+  }
+}
+===DONE===
@@ -0,0 +1,87 @@
+--TEST--
+property proxy cached property offsets
+--SKIPIF--
+<?php
+extension_loaded("propro") || print "skip";
+?>
+--FILE--
+<?php
+echo "Test\n";
+
+class a {
+	private $data = [];
+	function proxy($p) {
+		return new php\PropertyProxy($this, $p);
+	}
+	function data() {
+		return $this->data;
+	}
+}
+
+class b {
+	public $pad1, $pad2;
+	private $data = [];
+	function __get($p) {
+		echo "__get($p)\n";
+		return [];
+	}
+	function proxy($p) {
+		return new php\PropertyProxy($this, $p);
+	}
+	function data() {
+		return $this->data;
+	}
+	function drop() {
+		unset($this->data);
+	}
+}
+
+$a = new a;
+$b = new b;
+
+for ($i = 0; $i < 3; ++$i) {
+	$pa = $a->proxy("data");
+	$pa[$i] = "a$i";
+	$pb = $b->proxy("data");
+	$pb[$i] = "b$i";
+	$pd = $b->proxy("dyn");
+	$pd[$i] = $i;
+}
+
+var_dump($a->data(), $b->data(), $b->dyn);
+
+$b->drop();
+$pb = $b->proxy("data");
+var_dump(isset($pb[0]));
+?>
+===DONE===
+--EXPECTF--
+Test
+__get(dyn)
+array(3) {
+  [0]=>
+  string(2) "a0"
+  [1]=>
+  string(2) "a1"
+  [2]=>
+  string(2) "a2"
+}
+array(3) {
+  [0]=>
+  string(2) "b0"
+  [1]=>
+  string(2) "b1"
+  [2]=>
+  string(2) "b2"
+}
+array(3) {
+  [0]=>
+  int(0)
+  [1]=>
+  int(1)
+  [2]=>
+  int(2)
+}
+__get(data)
+bool(false)
+===DONE===
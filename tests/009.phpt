@@ -0,0 +1,93 @@
+--TEST--
+property proxy iteration
+--SKIPIF--
+<?php
+extension_loaded("propro") || print "skip";
+?>
+--FILE--
+<?php
+echo "Test\n";
+
+class c {
+	public $list = ["a" => 1, "b" => 2, 3];
+	public $obj;
+	private $priv = [];
+	function __construct() {
+		$this->obj = new stdClass;
+		$this->obj->x = "x";
+		$this->obj->y = "y";
+	}
+	function proxy($p) {
+		return new php\PropertyProxy($this, $p);
+	}
+}
+
+$c = new c;
+
+$p = $c->proxy("list");
+var_dump($p instanceof Traversable);
+foreach ($p as $k => $v) {
+	echo "$k=$v\n";
+}
+
+foreach ($p as &$v) {
+	$v *= 10;
+}
+unset($v);
+var_dump($c->list);
+
+$n = $c->proxy("nested");
+foreach ($n["a"]["b"] as &$v) {
+	$v = 1;
+}
+unset($v);
+var_dump($c->nested);
+
+$o = $c->proxy("obj");
+foreach ($o as $k => $v) {
+	echo "$k=$v\n";
+}
+
+$a = $c->proxy("arrobj");
+$c->arrobj = new ArrayObject([1, 2]);
+var_dump(iterator_to_array($a));
+
+$u = $c->proxy("undefined");
+foreach ($u as $v) {
+	echo "never\n";
+}
+?>
+===DONE===
+--EXPECTF--
+Test
+bool(true)
+a=1
+b=2
+0=3
+array(3) {
+  ["a"]=>
+  int(10)
+  ["b"]=>
+  int(20)
+  [0]=>
+  int(30)
+}
+array(1) {
+  ["a"]=>
+  array(1) {
+    ["b"]=>
+    array(0) {
+    }
+  }
+}
+x=x
+y=y
+array(2) {
+  [0]=>
+  int(1)
+  [1]=>
+  int(2)
+}
+
+Notice: Undefined property: c::$undefined in %s on line %d
+===DONE===
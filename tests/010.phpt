@@ -0,0 +1,52 @@
+--TEST--
+property proxy count
+--SKIPIF--
+<?php
+extension_loaded("propro") || print "skip";
+?>
+--FILE--
+<?php
+echo "Test\n";
+
+class c {
+	public $list = [1, 2, 3];
+	public $none;
+	public $obj;
+	function proxy($p) {
+		return new php\PropertyProxy($this, $p);
+	}
+}
+
+class cnt implements Countable {
+	function count() {
+		return 42;
+	}
+}
+
+$c = new c;
+$l = $c->proxy("list");
+$n = $c->proxy("none");
+$o = $c->proxy("obj");
+$p = $c->proxy("page");
+
+var_dump(count($l), count($n));
+
+$c->obj = new ArrayObject([1, 2]);
+var_dump(count($o));
+$c->obj = new cnt;
+var_dump(count($o));
+
+$p["items"][] = 1;
+$p["items"][] = 2;
+var_dump(count($p), count($p["items"]));
+?>
+===DONE===
+--EXPECT--
+Test
+int(3)
+int(0)
+int(2)
+int(42)
+int(1)
+int(2)
+===DONE===
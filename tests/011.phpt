@@ -0,0 +1,66 @@
+--TEST--
+property proxy object-style chaining
+--SKIPIF--
+<?php
+extension_loaded("propro") || print "skip";
+?>
+--FILE--
+<?php
+echo "Test\n";
+
+class c {
+	private $config;
+	private $settings = [];
+	function __construct() {
+		$this->config = new stdClass;
+		$this->config->db = new stdClass;
+	}
+	function __get($p) {
+		return new php\PropertyProxy($this, $p);
+	}
+	function dump() {
+		var_dump($this->config, $this->settings);
+	}
+}
+
+$c = new c;
+$c->config->db->host = "localhost";
+$c->config->db->port = 3306;
+$c->settings->mail->from = "me@example.com";
+$c->settings->mail->to = "you@example.com";
+
+var_dump(isset($c->config->db->host), isset($c->config->db->user));
+var_dump($c->config->db->host, $c->settings->mail);
+
+unset($c->config->db->port);
+unset($c->settings->mail->to);
+
+$c->dump();
+?>
+===DONE===
+--EXPECTF--
+Test
+bool(true)
+bool(false)
+string(9) "localhost"
+array(2) {
+  ["from"]=>
+  string(14) "me@example.com"
+  ["to"]=>
+  string(15) "you@example.com"
+}
+object(stdClass)#%d (1) {
+  ["db"]=>
+  object(stdClass)#%d (1) {
+    ["host"]=>
+    string(9) "localhost"
+  }
+}
+array(1) {
+  ["mail"]=>
+  array(1) {
+    ["from"]=>
+    string(14) "me@example.com"
+  }
+}
+===DONE===
@@ -0,0 +1,59 @@
+--TEST--
+property proxy batch writes
+--SKIPIF--
+<?php
+extension_loaded("propro") || print "skip";
+?>
+--FILE--
+<?php
+echo "Test\n";
+
+class c {
+	public $sets = 0;
+	public $data = ["keep" => true, "drop" => true];
+	private $virt = [];
+	function __get($p) {
+		return $this->virt[$p] ?? null;
+	}
+	function __set($p, $v) {
+		++$this->sets;
+		$this->virt[$p] = $v;
+	}
+	function proxy($p) {
+		return new php\PropertyProxy($this, $p);
+	}
+}
+
+$c = new c;
+
+$d = $c->proxy("data");
+$d->assign(["a" => 1, "b" => 2, 3, "4" => 4]);
+$d->remove(["drop", "b", 0]);
+var_dump($c->data);
+
+$m = $c->proxy("magic");
+$f = new php\PropertyProxy(null, "form", $m);
+$f->assign(array_fill_keys(range("a", "z"), 1));
+$f->remove(range("b", "z"));
+var_dump($c->sets, $c->magic);
+?>
+===DONE===
+--EXPECT--
+Test
+array(3) {
+  ["keep"]=>
+  bool(true)
+  ["a"]=>
+  int(1)
+  [4]=>
+  int(4)
+}
+int(2)
+array(1) {
+  ["form"]=>
+  array(1) {
+    ["a"]=>
+    int(1)
+  }
+}
+===DONE===
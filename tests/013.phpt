@@ -0,0 +1,56 @@
+--TEST--
+property proxy deferred write back
+--SKIPIF--
+<?php
+extension_loaded("propro") || print "skip";
+?>
+--FILE--
+<?php
+echo "Test\n";
+
+class c {
+	public $sets = 0;
+	private $virt = [];
+	function __get($p) {
+		return $this->virt[$p] ?? null;
+	}
+	function __set($p, $v) {
+		++$this->sets;
+		$this->virt[$p] = $v;
+	}
+	function proxy($p) {
+		return new php\PropertyProxy($this, $p);
+	}
+}
+
+$c = new c;
+$p = $c->proxy("data");
+$p->defer();
+
+for ($i = 0; $i < 10; ++$i) {
+	$p["list"][] = $i;
+}
+$p["a"]["b"] = 1;
+var_dump($c->sets, count($p["list"]), $p["a"]["b"]);
+
+$p->commit();
+var_dump($c->sets);
+$p->commit();
+var_dump($c->sets);
+
+$p["x"] = 1;
+unset($p);
+var_dump($c->sets, $c->data["x"], count($c->data["list"]));
+?>
+===DONE===
+--EXPECT--
+Test
+int(0)
+int(10)
+int(1)
+int(1)
+int(1)
+int(2)
+int(1)
+int(10)
+===DONE===
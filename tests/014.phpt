@@ -0,0 +1,54 @@
+--TEST--
+property proxy read cache
+--SKIPIF--
+<?php
+extension_loaded("propro") || print "skip";
+?>
+--FILE--
+<?php
+echo "Test\n";
+
+class c {
+	public $gets = 0;
+	private $virt = ["data" => ["a" => 1, "b" => 2]];
+	function __get($p) {
+		++$this->gets;
+		return $this->virt[$p] ?? null;
+	}
+	function __set($p, $v) {
+		$this->virt[$p] = $v;
+	}
+	function proxy($p) {
+		return new php\PropertyProxy($this, $p);
+	}
+}
+
+$c = new c;
+$p = $c->proxy("data");
+$p->cache();
+
+var_dump($p["a"], $p["b"], count($p));
+var_dump($c->gets);
+
+$q = $c->proxy("data");
+$q["a"] = 3;
+var_dump($p["a"], $p["b"]);
+var_dump($c->gets);
+
+$p->cache(false);
+$p["a"];
+$p["b"];
+var_dump($c->gets);
+?>
+===DONE===
+--EXPECT--
+Test
+int(1)
+int(2)
+int(2)
+int(1)
+int(3)
+int(2)
+int(3)
+int(5)
+===DONE===
@@ -0,0 +1,53 @@
+--TEST--
+property proxy statistics
+--SKIPIF--
+<?php
+extension_loaded("propro") || print "skip";
+?>
+--FILE--
+<?php
+echo "Test\n";
+
+$o = new stdClass;
+$o->a = ["x" => ["y" => 1]];
+$copy = $o->a;
+
+$s = php\propro_stats();
+print_r(array_keys($s));
+
+$p = new php\PropertyProxy($o, "a");
+$p["x"]["y"] = 2;
+unset($p);
+
+$t = php\propro_stats();
+var_dump($t["proxies_created"] - $s["proxies_created"]);
+var_dump($t["proxies_freed"] - $s["proxies_freed"]);
+var_dump($t["depths"][1] - $s["depths"][1]);
+var_dump($t["depths"][2] - $s["depths"][2]);
+var_dump($t["separations"] > $s["separations"]);
+var_dump($t["separated_bytes"] > $s["separated_bytes"]);
+var_dump($o->a["x"]["y"], $copy["x"]["y"]);
+?>
+===DONE===
+--EXPECT--
+Test
+Array
+(
+    [0] => proxies_created
+    [1] => proxies_freed
+    [2] => allocations
+    [3] => separations
+    [4] => separated_bytes
+    [5] => writebacks
+    [6] => key_conversions
+    [7] => depths
+)
+int(2)
+int(2)
+int(1)
+int(1)
+bool(true)
+bool(true)
+int(2)
+int(1)
+===DONE===
@@ -0,0 +1,69 @@
+--TEST--
+property proxy writes do not scale with the array size
+--SKIPIF--
+<?php
+extension_loaded("propro") || print "skip";
+getenv("SKIP_SLOW_TESTS") && print "skip slow test";
+?>
+--FILE--
+<?php
+echo "Test\n";
+
+function measure($size, $shared) {
+	/* a hash from the start, so that the string key below does not convert
+	 * a packed array and rehash all of its elements */
+	$list = ["k" => []];
+	$list["k"]["v"] = -1;
+	$list += range(0, $size - 1);
+
+	$o = new stdClass;
+	$o->list = $list;
+	$list = $shared ? $o->list : null;
+	$p = new php\PropertyProxy($o, "list");
+
+	$stats = php\propro_stats();
+	$memory = memory_get_usage();
+	for ($i = 0; $i < 100; ++$i) {
+		$p[$i] = -$i;
+		$p["k"]["v"] = $i;
+	}
+	$memory = memory_get_usage() - $memory;
+	$after = php\propro_stats();
+
+	return [
+		"memory" => $memory,
+		"separations" => $after["separations"] - $stats["separations"],
+		"bytes" => $after["separated_bytes"] - $stats["separated_bytes"],
+	];
+}
+
+/* warm up the proxy pool */
+measure(100, false);
+
+foreach ([false, true] as $shared) {
+	foreach ([100, 10000, 100000] as $size) {
+		$m = measure($size, $shared);
+		/* only a shared array and the array it shares in turn are copied,
+		 * each of them once */
+		printf("%s %6d separations: %d\n", $shared ? "shared" : "owned ",
+				$size, $m["separations"]);
+		if ($shared ? $m["bytes"] < 16 * $size : $m["bytes"]) {
+			printf("bytes: %d\n", $m["bytes"]);
+		}
+		/* the copies are all the memory the writes take */
+		if ($m["memory"] > $m["bytes"] + 4096) {
+			printf("memory: %d vs. %d\n", $m["memory"], $m["bytes"]);
+		}
+	}
+}
+?>
+===DONE===
+--EXPECT--
+Test
+owned     100 separations: 0
+owned   10000 separations: 0
+owned  100000 separations: 0
+shared    100 separations: 2
+shared  10000 separations: 2
+shared 100000 separations: 2
+===DONE===
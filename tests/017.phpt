@@ -0,0 +1,46 @@
+--TEST--
+property proxy writes scale linearly with the nesting depth
+--SKIPIF--
+<?php
+extension_loaded("propro") || print "skip";
+?>
+--FILE--
+<?php
+echo "Test\n";
+
+function measure($depth) {
+	$o = new stdClass;
+	$o->data = [];
+	$p = new php\PropertyProxy($o, "data");
+	for ($i = 1; $i < $depth; ++$i) {
+		$p = new php\PropertyProxy(null, "l$i", $p);
+	}
+	/* create the nested arrays */
+	$p["v"] = 0;
+
+	$stats = php\propro_stats();
+	for ($i = 0; $i < 2000; ++$i) {
+		$p["v"] = $i;
+	}
+	$after = php\propro_stats();
+
+	/* a write descends the path once, without copying or proxying a level */
+	printf("%3d proxies: %d separations: %d bytes: %d\n", $depth,
+			$after["proxies_created"] - $stats["proxies_created"],
+			$after["separations"] - $stats["separations"],
+			$after["separated_bytes"] - $stats["separated_bytes"]);
+}
+
+foreach ([8, 16, 32, 64, 128] as $depth) {
+	measure($depth);
+}
+?>
+===DONE===
+--EXPECT--
+Test
+  8 proxies: 0 separations: 0 bytes: 0
+ 16 proxies: 0 separations: 0 bytes: 0
+ 32 proxies: 0 separations: 0 bytes: 0
+ 64 proxies: 0 separations: 0 bytes: 0
+128 proxies: 0 separations: 0 bytes: 0
+===DONE===
@@ -0,0 +1,40 @@
+--TEST--
+property proxy interned child proxies
+--SKIPIF--
+<?php
+extension_loaded("propro") || print "skip";
+?>
+--FILE--
+<?php
+echo "Test\n";
+
+$o = new stdClass;
+$o->data = [];
+$p = new php\PropertyProxy($o, "data");
+
+$s = php\propro_stats();
+for ($i = 0; $i < 100; ++$i) {
+	$p["bar"][] = $i;
+	$p["baz"]["x"]["y"] = $i;
+	$p->qux["z"] = $i;
+}
+$t = php\propro_stats();
+var_dump($t["proxies_created"] - $s["proxies_created"]);
+var_dump(count($o->data["bar"]), $o->data["baz"]["x"]["y"], $o->data["qux"]["z"]);
+
+$p->defer();
+$p["bar"][] = 100;
+var_dump(count($o->data["bar"]));
+$p->commit();
+var_dump(count($o->data["bar"]));
+?>
+===DONE===
+--EXPECT--
+Test
+int(4)
+int(100)
+int(99)
+int(99)
+int(100)
+int(101)
+===DONE===
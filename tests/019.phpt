@@ -0,0 +1,54 @@
+--TEST--
+property proxy appends through references returned by __get
+--SKIPIF--
+<?php
+extension_loaded("propro") || print "skip";
+?>
+--FILE--
+<?php
+echo "Test\n";
+
+class byref {
+	public $sets = 0;
+	private $props = ["list" => []];
+	function &__get($p) {
+		return $this->props[$p];
+	}
+	function __set($p, $v) {
+		++$this->sets;
+		$this->props[$p] = $v;
+	}
+}
+
+class byval {
+	public $sets = 0;
+	private $props = ["list" => []];
+	function __get($p) {
+		return $this->props[$p];
+	}
+	function __set($p, $v) {
+		++$this->sets;
+		$this->props[$p] = $v;
+	}
+}
+
+foreach ([new byref, new byval] as $o) {
+	$p = new php\PropertyProxy($o, "list");
+	$s = php\propro_stats();
+	for ($i = 0; $i < 1000; ++$i) {
+		$p[] = $i;
+	}
+	$p["nested"][] = "x";
+	$t = php\propro_stats();
+
+	printf("%s sets: %d writebacks: %d count: %d last: %d nested: %s\n",
+			get_class($o), $o->sets, $t["writebacks"] - $s["writebacks"],
+			count($o->list), $o->list[999], $o->list["nested"][0]);
+}
+?>
+===DONE===
+--EXPECT--
+Test
+byref sets: 0 writebacks: 0 count: 1001 last: 999 nested: x
+byval sets: 1001 writebacks: 1001 count: 1001 last: 999 nested: x
+===DONE===
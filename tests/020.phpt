@@ -0,0 +1,62 @@
+--TEST--
+property proxy compiled paths
+--SKIPIF--
+<?php
+extension_loaded("propro") || print "skip";
+?>
+--FILE--
+<?php
+echo "Test\n";
+
+$path = php\PropertyProxy::compile("a.b[3].c");
+var_dump($path instanceof php\PropertyPath);
+
+$array = [];
+$path->set($array, 1);
+var_dump($array === ["a" => ["b" => [3 => ["c" => 1]]]]);
+var_dump($path->get($array), $path->has($array));
+
+$object = new stdClass;
+$object->a = ["b" => [3 => ["c" => 2, "d" => 3]]];
+var_dump($path->get($object), $path->has($object));
+$path->unset($object);
+var_dump($path->has($object), $object->a["b"][3]);
+
+$missing = new php\PropertyPath("x.y");
+$missing->unset($object);
+var_dump(isset($object->x), $missing->get($object));
+
+foreach (["", "a.", ".a", "a..b", "a[1", "a[]", "a[1]b", "a.[1]"] as $invalid) {
+	try {
+		php\PropertyProxy::compile($invalid);
+		echo "valid: $invalid\n";
+	} catch (Throwable $e) {
+		echo "invalid: $invalid\n";
+	}
+}
+?>
+===DONE===
+--EXPECT--
+Test
+bool(true)
+bool(true)
+int(1)
+bool(true)
+int(2)
+bool(true)
+bool(false)
+array(1) {
+  ["d"]=>
+  int(3)
+}
+bool(false)
+NULL
+invalid: 
+invalid: a.
+invalid: .a
+invalid: a..b
+invalid: a[1
+invalid: a[]
+invalid: a[1]b
+invalid: a.[1]
+===DONE===
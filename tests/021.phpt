@@ -0,0 +1,84 @@
+--TEST--
+property proxy gather and scatter
+--SKIPIF--
+<?php
+extension_loaded("propro") || print "skip";
+?>
+--FILE--
+<?php
+echo "Test\n";
+
+class row {
+	public $data;
+	function __construct($id) {
+		$this->data = ["id" => $id, "tags" => ["t$id"]];
+	}
+}
+
+$rows = [new row(1), ["data" => ["id" => 2]], new row(3), "x" => new row(4)];
+var_dump(php\PropertyProxy::gather($rows, "data.id"));
+var_dump(php\PropertyProxy::gather(new ArrayIterator($rows), ["data", "tags", 0]));
+var_dump(php\PropertyProxy::gather($rows, new php\PropertyPath("data.tags[0]")));
+
+php\PropertyProxy::scatter($rows, "data.id", [10, 20, 30]);
+var_dump(php\PropertyProxy::gather($rows, "data.id"));
+var_dump($rows[1]);
+
+try {
+	php\PropertyProxy::gather(1, "data");
+} catch (Throwable $e) {
+	echo "not iterable\n";
+}
+?>
+===DONE===
+--EXPECT--
+Test
+array(4) {
+  [0]=>
+  int(1)
+  [1]=>
+  int(2)
+  [2]=>
+  int(3)
+  [3]=>
+  int(4)
+}
+array(4) {
+  [0]=>
+  string(2) "t1"
+  [1]=>
+  NULL
+  [2]=>
+  string(2) "t3"
+  [3]=>
+  string(2) "t4"
+}
+array(4) {
+  [0]=>
+  string(2) "t1"
+  [1]=>
+  NULL
+  [2]=>
+  string(2) "t3"
+  [3]=>
+  string(2) "t4"
+}
+array(4) {
+  [0]=>
+  int(10)
+  [1]=>
+  int(20)
+  [2]=>
+  int(30)
+  [3]=>
+  int(4)
+}
+array(1) {
+  ["data"]=>
+  array(1) {
+    ["id"]=>
+    int(20)
+  }
+}
+not iterable
+===DONE===
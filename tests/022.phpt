@@ -0,0 +1,67 @@
+--TEST--
+property proxy json_encode and serialize
+--SKIPIF--
+<?php
+extension_loaded("propro") || print "skip";
+extension_loaded("json") || print "skip";
+?>
+--FILE--
+<?php
+echo "Test\n";
+
+class c {
+	private $data = ["list" => [1, 2, 3], "map" => ["a" => "x"]];
+	function __get($p) {
+		return $this->$p ?? null;
+	}
+	function __set($p, $v) {
+		$this->$p = $v;
+	}
+	function proxy($p) {
+		return new php\PropertyProxy($this, $p);
+	}
+}
+
+$c = new c;
+$p = $c->proxy("data");
+
+var_dump($p instanceof JsonSerializable);
+echo json_encode($p), "\n";
+$m = new php\PropertyProxy(null, "map", $p);
+echo json_encode(["payload" => $m]), "\n";
+echo json_encode($c->proxy("missing")), "\n";
+
+$p->defer();
+$p["list"][] = 4;
+echo json_encode($p["list"]), "\n";
+$p->commit();
+
+$s = serialize($m);
+echo $s, "\n";
+$u = unserialize($s);
+var_dump($u instanceof php\PropertyProxy);
+var_dump($u["a"]);
+$u["b"] = "y";
+echo json_encode($u), "\n";
+
+$o = new stdClass;
+$s = serialize([$o, (new php\PropertyProxy((object) ["o" => $o], "o"))]);
+$u = unserialize($s);
+$u[1]->x = 1;
+var_dump($u[0]->x);
+
+?>
+===DONE===
+--EXPECTF--
+Test
+bool(true)
+{"list":[1,2,3],"map":{"a":"x"}}
+{"payload":{"a":"x"}}
+null
+[1,2,3,4]
+C:17:"php\PropertyProxy":22:{a:1:{s:1:"a";s:1:"x";}}
+bool(true)
+string(1) "x"
+{"a":"x","b":"y"}
+int(1)
+===DONE===
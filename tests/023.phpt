@@ -0,0 +1,78 @@
+--TEST--
+property proxy cycle collector modes
+--SKIPIF--
+<?php
+extension_loaded("propro") || print "skip";
+version_compare(PHP_VERSION, "7.4", ">=") || print "skip PHP >= 7.4 required";
+?>
+--FILE--
+<?php
+echo "Test\n";
+
+class c {
+	public $data = ["a" => 1, "b" => ["c" => 2]];
+	function __destruct() {
+		echo "destruct\n";
+	}
+}
+
+$o = new c;
+$p = new php\PropertyProxy($o, "data");
+$q = new php\PropertyProxy($o, "data");
+$q->untrack();
+$r = new php\PropertyProxy(null, "b", $q);
+
+gc_collect_cycles();
+$x = $p;
+unset($x);
+var_dump(gc_status()["roots"]);
+
+gc_collect_cycles();
+$x = $q;
+unset($x);
+var_dump(gc_status()["roots"]);
+
+gc_collect_cycles();
+$x = $r;
+unset($x);
+var_dump(gc_status()["roots"]);
+
+unset($p, $q, $r);
+
+$p = new php\PropertyProxy($o, "data");
+$p->weaken();
+$c = new php\PropertyProxy(null, "b", $p);
+var_dump($p["a"], $c["c"]);
+$c["c"] = 3;
+var_dump($o->data["b"]["c"]);
+
+unset($o);
+var_dump($p["a"], $c["c"], isset($p["a"]));
+$p["a"] = 1;
+
+$o = new stdClass;
+$o->x = [];
+$d = new php\PropertyProxy($o, "x");
+$d->defer();
+try {
+	(new php\PropertyProxy(null, "y", $d))->weaken();
+} catch (Throwable $e) {
+	echo $e->getMessage(), "\n";
+}
+
+?>
+===DONE===
+--EXPECT--
+Test
+int(1)
+int(0)
+int(0)
+int(1)
+int(2)
+int(3)
+destruct
+NULL
+NULL
+bool(false)
+Container cannot be weakly referenced
+===DONE===
@@ -0,0 +1,60 @@
+--TEST--
+property proxy change journal
+--SKIPIF--
+<?php
+extension_loaded("propro") || print "skip";
+?>
+--FILE--
+<?php
+echo "Test\n";
+
+use php\PropertyProxy;
+
+class c {
+	public $data = ["a" => ["b" => 1], "l" => [], 3 => null];
+}
+
+$o = new c;
+$p = new PropertyProxy($o, "data");
+PropertyProxy::journal($o);
+
+$p["a"]["b"] = 2;
+$p["l"][] = 1;
+$p["a"]["b"] = 3;
+$p[3] = 1;
+echo json_encode(PropertyProxy::changes($o)), "\n";
+
+$p["a"] = ["x" => 1];
+$p["a"]["y"] = 1;
+echo json_encode(PropertyProxy::changes($o)), "\n";
+
+PropertyProxy::clearChanges($o);
+$r = new PropertyProxy($o, "data");
+unset($r["a"]["x"], $r["l"]);
+echo json_encode(PropertyProxy::changes($o)), "\n";
+
+PropertyProxy::clearChanges($o);
+$p->defer();
+$p["z"] = 1;
+echo json_encode(PropertyProxy::changes($o)), "\n";
+$p->commit();
+echo json_encode(PropertyProxy::changes($o)), "\n";
+
+PropertyProxy::journal($o, false);
+try {
+	PropertyProxy::changes($o);
+} catch (Throwable $e) {
+	echo $e->getMessage(), "\n";
+}
+
+?>
+===DONE===
+--EXPECT--
+Test
+[["data","a","b"],["data","l"],["data",3]]
+[["data","l"],["data",3],["data","a"]]
+[["data","a","x"],["data","l"]]
+[]
+[["data"]]
+Changes of the container are not journaled
+===DONE===
@@ -0,0 +1,75 @@
+--TEST--
+property proxy capacity hints
+--SKIPIF--
+<?php
+extension_loaded("propro") || print "skip";
+?>
+--FILE--
+<?php
+echo "Test\n";
+
+$o = new stdClass;
+$p = new php\PropertyProxy($o, "list");
+$p->reserve(1000);
+var_dump($o->list);
+
+$p[] = 0;
+$stats = php\propro_stats();
+for ($i = 1; $i < 1000; ++$i) {
+	$p[] = $i;
+}
+$after = php\propro_stats();
+/* appending into the reserved table does not copy it */
+var_dump($after["separations"] - $stats["separations"],
+		$after["separated_bytes"] - $stats["separated_bytes"]);
+var_dump(count($o->list), $o->list[999]);
+
+$o->scalar = "x";
+$q = new php\PropertyProxy($o, "scalar");
+$q->reserve(10, false);
+$q["k"] = 1;
+var_dump($o->scalar);
+
+$o->map = ["a" => 1];
+$m = new php\PropertyProxy($o, "map");
+$m->reserve(10);
+$m["b"] = 2;
+var_dump($o->map);
+
+$m->defer();
+$m->reserve(10);
+$m["c"] = 3;
+$m->commit();
+var_dump(count($o->map));
+
+try {
+	$p->reserve(-1);
+} catch (Throwable $e) {
+	echo $e->getMessage(), "\n";
+}
+
+?>
+===DONE===
+--EXPECTF--
+Test
+array(0) {
+}
+int(0)
+int(0)
+int(1000)
+int(999)
+array(2) {
+  [0]=>
+  string(1) "x"
+  ["k"]=>
+  int(1)
+}
+array(2) {
+  ["a"]=>
+  int(1)
+  ["b"]=>
+  int(2)
+}
+int(3)
+Capacity must be between 0 and %d
+===DONE===
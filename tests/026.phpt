@@ -0,0 +1,42 @@
+--TEST--
+property proxy deferring writes to a weakly referenced container
+--SKIPIF--
+<?php
+extension_loaded("propro") || print "skip";
+version_compare(PHP_VERSION, "7.4", ">=") || print "skip PHP >= 7.4 required";
+?>
+--FILE--
+<?php
+echo "Test\n";
+
+class c {
+	public $data = ["a" => 1];
+	function __destruct() {
+		echo "destruct\n";
+	}
+}
+
+$o = new c;
+$p = new php\PropertyProxy($o, "data");
+$p->weaken();
+$p->defer();
+$p["a"] = 2;
+unset($p);
+var_dump($o->data["a"]);
+
+$p = new php\PropertyProxy($o, "data");
+$p->weaken();
+$p->defer();
+$p["a"] = 3;
+unset($o);
+var_dump($p["a"]);
+unset($p);
+
+?>
+===DONE===
+--EXPECT--
+Test
+int(2)
+destruct
+int(3)
+===DONE===
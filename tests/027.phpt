@@ -0,0 +1,83 @@
+--TEST--
+property proxy native accessors
+--SKIPIF--
+<?php
+extension_loaded("propro") || print "skip";
+class_exists("php\\PropertyProxyTest") || print "skip need --enable-propro-test";
+?>
+--FILE--
+<?php
+echo "Test\n";
+
+$t = new php\PropertyProxyTest(["list" => [1, 2], "str" => "s"]);
+$p = $t->proxy("list");
+
+var_dump(count($p), isset($p[0]), isset($p[5]), empty($p[1]));
+
+$stats = php\propro_stats();
+$p[] = 3;
+$p["k"]["v"] = 1;
+unset($p[0]);
+var_dump(php\propro_stats()["writebacks"] - $stats["writebacks"]);
+
+var_dump($p[1]);
+foreach ($p as $k => $v) {
+	echo "$k\n";
+}
+
+var_dump($t->toArray());
+var_dump($t->calls());
+?>
+===DONE===
+--EXPECT--
+Test
+int(2)
+bool(true)
+bool(false)
+bool(false)
+int(2)
+int(2)
+1
+2
+k
+array(2) {
+  ["list"]=>
+  array(3) {
+    [1]=>
+    int(2)
+    [2]=>
+    int(3)
+    ["k"]=>
+    array(1) {
+      ["v"]=>
+      int(1)
+    }
+  }
+  ["str"]=>
+  string(1) "s"
+}
+array(11) {
+  [0]=>
+  string(11) "count(list)"
+  [1]=>
+  string(12) "has(list, 0)"
+  [2]=>
+  string(12) "has(list, 5)"
+  [3]=>
+  string(12) "has(list, 1)"
+  [4]=>
+  string(9) "get(list)"
+  [5]=>
+  string(9) "set(list)"
+  [6]=>
+  string(9) "get(list)"
+  [7]=>
+  string(9) "set(list)"
+  [8]=>
+  string(14) "unset(list, 0)"
+  [9]=>
+  string(9) "get(list)"
+  [10]=>
+  string(9) "get(list)"
+}
+===DONE===
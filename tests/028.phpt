@@ -0,0 +1,55 @@
+--TEST--
+property proxy deferred writes at the end of the request
+--SKIPIF--
+<?php
+extension_loaded("propro") || print "skip";
+?>
+--FILE--
+<?php
+echo "Test\n";
+
+class c {
+	public $data = [];
+	public $more = [];
+	static $keep;
+}
+
+$c = new c;
+$p = new php\PropertyProxy($c, "data");
+$p->defer();
+$p["x"] = 1;
+
+$q = new php\PropertyProxy($c, "more");
+$q->defer();
+$q[] = 1;
+php\propro_commit_all();
+var_dump($c->data, $c->more);
+$q[] = 2;
+
+register_shutdown_function(function() use ($c) {
+	/* committed by the shutdown function registered by defer() */
+	var_dump($c->more);
+	/* dropped at the end of the request */
+	c::$keep = new php\PropertyProxy($c, "data");
+	c::$keep->defer();
+	c::$keep["y"] = 2;
+});
+?>
+===DONE===
+--EXPECT--
+Test
+array(1) {
+  ["x"]=>
+  int(1)
+}
+array(1) {
+  [0]=>
+  int(1)
+}
+===DONE===
+array(2) {
+  [0]=>
+  int(1)
+  [1]=>
+  int(2)
+}
@@ -0,0 +1,43 @@
+--TEST--
+property proxy allocations
+--SKIPIF--
+<?php
+extension_loaded("propro") || print "skip";
+?>
+--FILE--
+<?php
+echo "Test\n";
+
+$o = new stdClass;
+$o->data = [];
+
+/* the proxy is allocated along with its object, not on its own */
+$s = php\propro_stats();
+$proxies = [];
+for ($i = 0; $i < 10; ++$i) {
+	$proxies[] = new php\PropertyProxy($o, "p$i");
+}
+$t = php\propro_stats();
+var_dump($t["proxies_created"] - $s["proxies_created"]);
+var_dump($t["allocations"] - $s["allocations"]);
+
+/* the child proxies of nested writes are allocated once */
+$p = new php\PropertyProxy($o, "data");
+$s = php\propro_stats();
+for ($i = 0; $i < 100; ++$i) {
+	$p["a"]["b"]["c"] = $i;
+}
+$t = php\propro_stats();
+var_dump($t["proxies_created"] - $s["proxies_created"]);
+var_dump($t["allocations"] - $s["allocations"]);
+var_dump($o->data["a"]["b"]["c"]);
+?>
+===DONE===
+--EXPECT--
+Test
+int(10)
+int(10)
+int(2)
+int(2)
+int(99)
+===DONE===
@@ -0,0 +1,41 @@
+--TEST--
+property proxy change journal of deep paths under several members
+--SKIPIF--
+<?php
+extension_loaded("propro") || print "skip";
+?>
+--FILE--
+<?php
+echo "Test\n";
+
+use php\PropertyProxy;
+
+class c {
+	public $one = ["a" => ["b" => 0]];
+	public $two = ["a" => ["b" => ["c" => 0]]];
+}
+
+$o = new c;
+$p = new PropertyProxy($o, "one");
+$q = new PropertyProxy($o, "two");
+PropertyProxy::journal($o);
+
+$p["a"]["b"] = 1;
+$q["a"]["b"]["c"] = 1;
+$p["a"]["b"] = 2;
+$q["a"]["b"]["c"] = 2;
+$q["a"]["b"]["d"] = 1;
+echo json_encode(PropertyProxy::changes($o)), "\n";
+
+$q["a"]["b"] = [];
+$q["a"]["b"]["c"] = 3;
+$p["a"]["b"] = 3;
+echo json_encode(PropertyProxy::changes($o)), "\n";
+
+?>
+===DONE===
+--EXPECT--
+Test
+[["one","a","b"],["two","a","b","c"],["two","a","b","d"]]
+[["one","a","b"],["two","a","b"]]
+===DONE===
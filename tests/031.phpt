@@ -0,0 +1,47 @@
+--TEST--
+property proxy change journal re-records dropped paths
+--SKIPIF--
+<?php
+extension_loaded("propro") || print "skip";
+?>
+--FILE--
+<?php
+echo "Test\n";
+
+use php\PropertyProxy;
+
+class c {
+	public $one = ["a" => ["b" => 0, "c" => 0]];
+}
+
+$o = new c;
+$p = new PropertyProxy($o, "one");
+PropertyProxy::journal($o);
+
+$p["a"]["b"] = 1;
+$p["a"]["c"] = 1;
+echo json_encode(PropertyProxy::changes($o)), "\n";
+
+$p["a"] = ["b" => 0];
+$p["a"]["b"] = 2;
+echo json_encode(PropertyProxy::changes($o)), "\n";
+
+PropertyProxy::clearChanges($o);
+$p["a"]["b"] = 3;
+unset($p["a"]["b"]);
+$p["a"]["c"] = 3;
+echo json_encode(PropertyProxy::changes($o)), "\n";
+
+unset($p["a"]);
+$p["a"]["b"] = 4;
+echo json_encode(PropertyProxy::changes($o)), "\n";
+
+?>
+===DONE===
+--EXPECT--
+Test
+[["one","a","b"],["one","a","c"]]
+[["one","a"]]
+[["one","a","b"],["one","a","c"]]
+[["one","a"]]
+===DONE===